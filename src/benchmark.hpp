@@ -0,0 +1,239 @@
+#pragma once
+#include "benchmark_baseline.hpp"
+#include "crossfade.hpp"
+
+// Draw every effect in the sketch for a fixed number of frames with a fixed
+// clock, on the real XYMap, and print a CSV of µs/frame and frame checksums.
+// Timings are compared against benchmark_baseline.hpp to flag regressions.
+// tools/effect_bench.cpp runs the same benchmarks on a PC.
+//
+// Effects are freshly constructed with a fixed random seed, and drawn with a
+// fixed clock, so checksums are repeatable between runs and builds.
+
+const int benchmarkFrames = 50;
+const uint32_t benchmarkFrameMs = 16;
+
+// FNV-1a, to detect any change in what an effect draws
+uint32_t frameChecksum(const CRGB *leds, uint16_t numLeds,
+                       uint32_t hash = 2166136261u) {
+    const uint8_t *bytes = (const uint8_t *)leds;
+    for (size_t i = 0; i < numLeds * sizeof(CRGB); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+// Baselines recorded by earlier runs, for benchmarks missing from the table
+Preferences benchmarkStore;
+
+// Print one line of CSV, and compare the timing against the baseline
+void benchmarkReport(const String &name, uint32_t µs, uint32_t checksum,
+                     uint16_t &regressions) {
+    uint32_t baseline = 0;
+    for (const BenchmarkBaseline *b = benchmarkBaseline; b->name; b++)
+        if (name == b->name)
+            baseline = b->µsPerFrame;
+
+    // NVS keys are at most 15 characters, so stored baselines are keyed by a
+    // hash of the name
+    uint32_t hash = 2166136261u;
+    for (const char *c = name.c_str(); *c; c++)
+        hash = (hash ^ uint8_t(*c)) * 16777619u;
+    char key[12];
+    snprintf(key, sizeof(key), "b%08lx", (unsigned long)hash);
+    const char *status = "ok";
+    if (!baseline)
+        baseline = benchmarkStore.getUInt(key, 0);
+    if (!baseline) {
+        benchmarkStore.putUInt(key, µs);
+        status = "recorded";
+    } else if (µs * 100 > baseline * (100 + BENCHMARK_THRESHOLD)) {
+        status = "REGRESSION", regressions++;
+    }
+    Serial.printf("%s,%lu,%08lx,%lu,%s\r\n", name.c_str(), µs, checksum,
+                  baseline, status);
+}
+
+// Draw benchmarkFrames frames of an effect, starting at time `now`
+uint32_t benchmarkFx(Fx &fx, CRGB *leds, uint32_t &now, uint32_t &checksum) {
+    checksum = 2166136261u;
+    fx.draw(Fx::DrawContext(now, leds)); // build any lazy state first
+    uint32_t µs = 0;
+    for (int i = 0; i < benchmarkFrames; i++) {
+        now += benchmarkFrameMs;
+        uint32_t start = micros();
+        fx.draw(Fx::DrawContext(now, leds));
+        µs += micros() - start;
+        checksum = frameChecksum(leds, NUM_LEDS, checksum);
+    }
+    return µs / benchmarkFrames;
+}
+
+// Returns how many benchmarks regressed
+uint16_t benchmarkEffects(CRGB *leds) {
+    uint16_t regressions = 0;
+    uint32_t now = 0, checksum, µs;
+    Serial.printf("name,us_per_frame,checksum,baseline_us,status\r\n");
+    benchmarkStore.begin("benchmark");
+
+    // Every Animartrix animation
+    random16_set_seed(1234);
+    Animartrix animartrix(xyMap, FIRST_ANIMATION);
+    for (int fx = 0; fx < NUM_ANIMATIONS; fx++) {
+        animartrix.fxSet(fx);
+        now = 0;
+        µs = benchmarkFx(animartrix, leds, now, checksum);
+        benchmarkReport("Animartrix " + String(fx), µs, checksum, regressions);
+    }
+
+    // Both NoisePalette presets, as configured in setup()
+    random16_set_seed(1234);
+    NoisePalette noise1(xyMap);
+    noise1.setPalettePreset(1);
+    noise1.setSpeed(3);
+    noise1.setScale(10);
+    µs = benchmarkFx(noise1, leds, now, checksum);
+    benchmarkReport("NoisePalette1", µs, checksum, regressions);
+
+    random16_set_seed(1234);
+    NoisePalette noise2(xyMap);
+    noise2.setPalettePreset(4);
+    µs = benchmarkFx(noise2, leds, now, checksum);
+    benchmarkReport("NoisePalette2", µs, checksum, regressions);
+
+    random16_set_seed(1234);
+    FxSui sui(xyMap);
+    sui.setEdgeDamping(255);
+    µs = benchmarkFx(sui, leds, now, checksum);
+    benchmarkReport("FxSui", µs, checksum, regressions);
+
+    // Every pair of effects, for the whole of an FxEngine crossfade
+    Fx *effects[] = {&animartrix, &noise1, &noise2, &sui};
+    const int numFx = sizeof(effects) / sizeof(effects[0]);
+    const uint16_t duration = benchmarkFrames * benchmarkFrameMs;
+    animartrix.fxSet(FIRST_ANIMATION);
+    FxEngine engine(NUM_LEDS);
+    for (int i = 0; i < numFx; i++)
+        engine.addFx(*effects[i]);
+    for (int from = 0; from < numFx; from++) {
+        for (int to = 0; to < numFx; to++) {
+            if (from == to)
+                continue;
+            random16_set_seed(1234);
+            engine.setNextFx(from, 0);
+            engine.draw(now += benchmarkFrameMs, leds);
+            engine.setNextFx(to, duration);
+            checksum = 2166136261u;
+            µs = 0;
+            for (int i = 0; i < benchmarkFrames; i++) {
+                now += benchmarkFrameMs;
+                uint32_t start = micros();
+                engine.draw(now, leds);
+                µs += micros() - start;
+                checksum = frameChecksum(leds, NUM_LEDS, checksum);
+            }
+            µs /= benchmarkFrames;
+            benchmarkReport("FxEngine " + String(from) + ">" + String(to), µs,
+                            checksum, regressions);
+        }
+    }
+
+    // And through Crossfader, which fades from a frozen frame instead, so
+    // each pair can be compared with FxEngine's
+    Crossfader crossfader(engine, NUM_LEDS);
+    crossfader.reporting = false;
+    for (int from = 0; from < numFx; from++) {
+        for (int to = 0; to < numFx; to++) {
+            if (from == to)
+                continue;
+            random16_set_seed(1234);
+            crossfader.to(from, 0);
+            crossfader.draw(now += benchmarkFrameMs, leds);
+            crossfader.draw(now += benchmarkFrameMs, leds);
+            crossfader.to(to, duration);
+            checksum = 2166136261u;
+            µs = 0;
+            for (int i = 0; i < benchmarkFrames; i++) {
+                now += benchmarkFrameMs;
+                uint32_t start = micros();
+                crossfader.draw(now, leds);
+                µs += micros() - start;
+                checksum = frameChecksum(leds, NUM_LEDS, checksum);
+            }
+            µs /= benchmarkFrames;
+            benchmarkReport("Crossfader " + String(from) + ">" + String(to),
+                            µs, checksum, regressions);
+        }
+    }
+
+    Serial.printf("%u regressions above %d%%\r\n", regressions,
+                  BENCHMARK_THRESHOLD);
+    benchmarkStore.end();
+    return regressions;
+}
+
+#if !defined(FASTLED_STUB_IMPL) // the PC has no ESP32 heap to count
+
+// Time updates by handle and by name, and count heap blocks allocated by them
+void benchmarkTelemetry() {
+    const int updates = 100000;
+    multi_heap_info_t before, after;
+    const Telemetry::Handle handle = telemetry.add("benchmark", String(0.f));
+    telemetry.set(handle, 1234.56f); // grow the String to its steady size
+
+    // set() only queues, so time batches which fit in the queue, and give
+    // the telemetry task time to empty it between them
+    const int batch = 32, batches = 20;
+    heap_caps_get_info(&before, MALLOC_CAP_DEFAULT);
+    uint32_t µs = 0;
+    for (int b = 0; b < batches; b++) {
+        delay(120);
+        µs -= micros();
+        for (int i = 0; i < batch; i++)
+            telemetry.set(handle, i / 100.f);
+        µs += micros();
+    }
+    heap_caps_get_info(&after, MALLOC_CAP_DEFAULT);
+    Serial.printf("Telemetry set\t%.0f updates/s\t%d heap blocks\r\n",
+                  batch * batches * 1e6f / µs,
+                  int(after.allocated_blocks - before.allocated_blocks));
+
+    // add() looks the name up under a lock, then queues like set()
+    µs = 0;
+    for (int b = 0; b < batches; b++) {
+        delay(120);
+        µs -= micros();
+        for (int i = 0; i < batch; i++)
+            telemetry.add("benchmark", String(i / 100.f));
+        µs += micros();
+    }
+    Serial.printf("Telemetry add\t%.0f updates/s\r\n",
+                  batch * batches * 1e6f / µs);
+
+    // Logging only captures arguments. A new LogSite each time avoids the
+    // rate limit, and 4 batches avoids flooding the logs.
+    µs = 0;
+    for (int b = 0; b < 4; b++) {
+        delay(120);
+        µs -= micros();
+        for (int i = 0; i < batch; i++) {
+            LogSite site;
+            logbook.write(site, logDebug, "Benchmark %d %.2f", i, i / 100.f);
+        }
+        µs += micros();
+    }
+    Serial.printf("Log write\t%.2fus\r\n", µs / (4.f * batch));
+
+    // Formatting happens when a value is sent, rather than on every update
+    char buffer[24];
+    µs = micros();
+    for (int i = 0; i < updates / 10; i++)
+        formatFloat(buffer, i / 100.f);
+    µs = micros() - µs;
+    Serial.printf("formatFloat\t%.0f/s\r\n", updates / 10 * 1e6f / µs);
+    µs = micros();
+    for (int i = 0; i < updates / 10; i++)
+        snprintf(buffer, sizeof(buffer), "%.2f", i / 100.f);
+    µs = micros() - µs;
+    Serial.printf("snprintf\t%.0f/s\r\n", updates / 10 * 1e6f / µs);
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Reference timings for benchmarkEffects(), in µs/frame. The ESP32-S3 and the
+// PC running tools/effect_bench.cpp each have a table, as their timings can't
+// be compared. To update one, run the benchmark on a known-good build and copy
+// the name and us_per_frame columns of its output into the table, above the
+// entry which ends it.
+//
+// Benchmarks missing from the table are compared against the timing of the
+// first run which measured them instead, which is kept in NVS. So the first
+// run on a board records its baseline, and later runs flag regressions from
+// it. Clear the "benchmark" preferences namespace to record a new one. On the
+// PC, NVS starts empty on each run, so only the table is compared.
+
+struct BenchmarkBaseline {
+    const char *name;
+    uint32_t µsPerFrame;
+};
+
+#if defined(FASTLED_STUB_IMPL)
+const BenchmarkBaseline benchmarkBaseline[] = {
+    {nullptr, 0}, // the end of the table
+};
+#else
+const BenchmarkBaseline benchmarkBaseline[] = {
+    {nullptr, 0}, // the end of the table
+};
+#endif
+
+// Flag a regression when a benchmark is this many percent slower than baseline
+#define BENCHMARK_THRESHOLD 10
@@ -0,0 +1,42 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Blend whole frames of bytes, for Crossfader. Nothing here depends on
+// Arduino or FastLED, so it can be built for a PC too.
+
+// Linearly interpolate from a to b by f/256, four bytes at a time. Even and odd
+// bytes are spread into 16-bit lanes so the products can't overflow into their
+// neighbours.
+inline uint32_t lerpWord(uint32_t a, uint32_t b, uint32_t f) {
+    const uint32_t mask = 0x00ff00ff;
+    uint32_t even = ((a & mask) * (256 - f) + (b & mask) * f) >> 8;
+    uint32_t odd = ((a >> 8) & mask) * (256 - f) + ((b >> 8) & mask) * f;
+    return (even & mask) | (odd & ~mask);
+}
+
+// Blend `numBytes` of src into dst: dst = src + (dst - src) * f / 256. Words
+// are copied in and out with memcpy, which compiles to single loads and
+// stores once both buffers are known to be aligned.
+inline void blendBytes(const uint8_t *src, uint8_t *dst, size_t numBytes,
+                       uint16_t f) {
+    if (0 == ((uintptr_t(src) | uintptr_t(dst)) & 3)) {
+        const uint8_t *s = (const uint8_t *)__builtin_assume_aligned(src, 4);
+        uint8_t *d = (uint8_t *)__builtin_assume_aligned(dst, 4);
+        for (size_t words = numBytes / 4; words; words--, s += 4, d += 4) {
+            uint32_t a, b;
+            memcpy(&a, s, 4);
+            memcpy(&b, d, 4);
+            b = lerpWord(a, b, f);
+            memcpy(d, &b, 4);
+        }
+        src = s;
+        dst = d;
+        numBytes &= 3;
+    }
+    while (numBytes--) {
+        *dst = (*src * (256 - f) + *dst * f) >> 8;
+        src++, dst++;
+    }
+}
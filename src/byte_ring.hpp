@@ -0,0 +1,68 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A fixed-size ring of bytes, for output which is produced faster than a
+// port drains it. A record is appended in pieces between start() and
+// commit(), and either all of it is kept or, if the ring fills up, none of
+// it, so the reader never sees half a line. The reader takes bytes out in
+// contiguous runs, which can be written straight from the ring. Only one
+// task may use it at a time.
+template <uint32_t N> class ByteRing {
+    static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+
+  public:
+    uint32_t drops = 0; // records discarded because the ring was full
+
+    size_t size() const { return head - tail; }
+    void clear() { tail = head = pending; }
+
+    // Start a record
+    void start() {
+        pending = head;
+        overflow = false;
+    }
+    void append(const char *data, size_t n) {
+        if (overflow || n > N - (pending - tail)) {
+            overflow = true;
+            return;
+        }
+        const uint32_t at = pending & (N - 1);
+        const size_t first = n < N - at ? n : N - at;
+        memcpy(buffer + at, data, first);
+        memcpy(buffer, data + first, n - first);
+        pending += n;
+    }
+    void append(const char *s) { append(s, strlen(s)); }
+    // Keep the record, or count a drop if it didn't fit. Returns false if
+    // the record was dropped.
+    bool commit() {
+        if (overflow) {
+            pending = head;
+            drops++;
+            return false;
+        }
+        head = pending;
+        return true;
+    }
+
+    // The oldest bytes which are contiguous in the ring, up to max
+    const char *peek(size_t &n, size_t max) const {
+        const uint32_t at = tail & (N - 1);
+        n = size();
+        if (n > N - at)
+            n = N - at;
+        if (n > max)
+            n = max;
+        return (const char *)buffer + at;
+    }
+    void consume(size_t n) { tail += n; }
+
+  private:
+    uint8_t buffer[N];
+    uint32_t head = 0;    // end of the committed records
+    uint32_t tail = 0;    // start of the oldest unread byte
+    uint32_t pending = 0; // end of the record being appended
+    bool overflow = false;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <FastLED.h>
+#include "fl/scoped_ptr.h"
+#include "fx/fx_engine.h"
+#include "blend_bytes.hpp"
+
+using namespace fl;
+
+// FxEngine renders both effects for the whole of a crossfade, which halves the
+// frame rate when one of them is Animartrix. Instead, keep a copy of the last
+// frame of the outgoing effect and fade from that, so a crossfade costs one
+// effect plus a blend.
+//
+// The frame rate of each crossfade is sent to telemetry as "xfade <from>><to>",
+// or "xfade <from>><to> both" when FxEngine renders both effects, to compare.
+#define CROSSFADE_MAX_FX 8 // effects whose crossfades are reported
+
+class Crossfader {
+  public:
+    Crossfader(FxEngine &engine, uint16_t numLeds)
+        : engine(engine), numLeds(numLeds), snapshot(new CRGB[numLeds]) {}
+
+    bool freeze = true;    // false to let FxEngine render both effects
+    bool reporting = true; // send the frame rate of each crossfade
+
+    bool to(int fxId, uint16_t duration);
+    void draw(uint32_t now, CRGB *leds);
+
+  private:
+    FxEngine &engine;
+    uint16_t numLeds;
+    fl::scoped_array<CRGB> snapshot; // last frame of the outgoing effect
+    int nextId = -1;                 // effect to crossfade to on the next draw
+    uint16_t nextMs = 0;             // and for how long
+    bool frozen = false;             // fading from snapshot, not FxEngine
+    uint32_t startMs = 0;            // when the current crossfade started
+    uint16_t durationMs = 0;         // 0 when not crossfading
+    int fromId = -1, toId = -1;      // effects crossfaded, for telemetry
+    uint32_t frames = 0;             // frames drawn during the crossfade
+    // "xfade" telemetry, by frozen, from and to, added on first use. A handle
+    // may be Telemetry::none if there was no room, so it isn't added again.
+    Telemetry::Handle fpsHandles[2][CROSSFADE_MAX_FX][CROSSFADE_MAX_FX] = {};
+    bool fpsAdded[2][CROSSFADE_MAX_FX][CROSSFADE_MAX_FX] = {};
+
+    void start(uint32_t now, CRGB *leds);
+    void reportFps(uint32_t now);
+};
+
+// Start a crossfade to an effect, from the next frame drawn. If a crossfade
+// is already under way, the new one starts from the blend on screen.
+bool Crossfader::to(int fxId, uint16_t duration) {
+    if (!engine.getFx(fxId))
+        return false;
+    nextId = fxId;
+    nextMs = duration;
+    return true;
+}
+
+// Draw the current effect, blended over the frozen outgoing frame if need be
+void Crossfader::draw(uint32_t now, CRGB *leds) {
+    engine.draw(now, leds);
+    if (durationMs) {
+        frames++;
+        const uint32_t elapsed = now - startMs;
+        if (elapsed >= durationMs)
+            reportFps(now);
+        else if (frozen)
+            blendBytes((const uint8_t *)snapshot.get(), (uint8_t *)leds,
+                       numLeds * sizeof(CRGB), (elapsed << 8) / durationMs);
+    }
+    if (nextId >= 0)
+        start(now, leds);
+}
+
+// Switch FxEngine to the next effect, fading from the frame just drawn
+void Crossfader::start(uint32_t now, CRGB *leds) {
+    if (durationMs)
+        reportFps(now);
+    fromId = engine.getCurrentFxId();
+    toId = nextId;
+    frozen = freeze;
+    if (frozen)
+        memcpy(snapshot.get(), leds, numLeds * sizeof(CRGB));
+    engine.setNextFx(nextId, frozen ? 0 : nextMs);
+    startMs = now;
+    durationMs = nextMs;
+    frames = 0;
+    nextId = -1;
+}
+
+// Report the frame rate achieved during a crossfade, per pair of effects
+void Crossfader::reportFps(uint32_t now) {
+    const uint32_t elapsed = now - startMs;
+    durationMs = 0;
+    if (!reporting || !elapsed || !frames || fromId < 0 ||
+        fromId >= CROSSFADE_MAX_FX || toId < 0 || toId >= CROSSFADE_MAX_FX)
+        return;
+    Telemetry::Handle &handle = fpsHandles[frozen][fromId][toId];
+    if (!fpsAdded[frozen][fromId][toId]) {
+        fpsAdded[frozen][fromId][toId] = true;
+        handle = telemetry.add("xfade " + String(fromId) + ">" + String(toId) +
+                                   (frozen ? "" : " both"),
+                               {.unit = "Hz", .teleplot = ""});
+    }
+    if (Telemetry::none != handle)
+        telemetry.set(handle, frames * 1000.f / elapsed);
+}
+
+// Compare FastLED's per-pixel blend with blendBytes() on a frame of NUM_LEDS
+void benchmarkBlend() {
+    const int iterations = 100;
+    uint32_t us;
+    uint32_t sum;
+    fl::scoped_array<CRGB> a(new CRGB[NUM_LEDS]);
+    fl::scoped_array<CRGB> b(new CRGB[NUM_LEDS]);
+    for (uint16_t i = 0; i < NUM_LEDS; i++)
+        a[i] = CHSV(i, 255, 255), b[i] = CHSV(i * 3, 255, 128);
+
+    us = micros(), sum = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        for (uint16_t j = 0; j < NUM_LEDS; j++)
+            b[j] = CRGB::blend(a[j], b[j], i);
+    us = micros() - us;
+    for (uint16_t j = 0; j < NUM_LEDS; j++)
+        sum += b[j].r + b[j].g + b[j].b;
+    Serial.printf("CRGB::blend\t%luus/frame \tsum: %lu\r\n", us / iterations,
+                  sum);
+
+    us = micros(), sum = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        blendBytes((const uint8_t *)a.get(), (uint8_t *)b.get(),
+                   NUM_LEDS * sizeof(CRGB), i);
+    us = micros() - us;
+    for (uint16_t j = 0; j < NUM_LEDS; j++)
+        sum += b[j].r + b[j].g + b[j].b;
+    Serial.printf("blendBytes\t%luus/frame \tsum: %lu\r\n", us / iterations,
+                  sum);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Compresses a stream of LED frames for the web preview. Each frame is XORed
+// with the last one encoded, so unchanged bytes become zeros, then coded as
+// runs: a varint count of bytes to skip, a varint count of literal bytes,
+// and the literals, repeated until the last changed byte. Runs of fewer than
+// 4 unchanged bytes stay in the literals, where they cost less than ending
+// the run would, so a frame never codes larger than FrameEncoder::maxSize.
+// A key frame is coded against black, so a viewer can start from it.
+//
+// Each message starts with a header:
+//   kind (frameKey or frameDelta), 0, bytes per frame (uint16, little-endian)
+// frameDecode() undoes it, as does the JavaScript in web_pages.hpp. Nothing
+// here depends on Arduino.
+
+#define FRAME_DELTA_HEADER 4
+#define FRAME_DELTA_MIN_SKIP 4 // unchanged bytes worth ending a literal run
+
+enum FrameDeltaKind : uint8_t { frameKey = 1, frameDelta = 2 };
+
+template <uint16_t N> class FrameEncoder {
+  public:
+    // The header, the first run's two varints, then at worst every byte
+    static const size_t maxSize = FRAME_DELTA_HEADER + 6 + N;
+
+    // Encode frame into out, which must hold maxSize bytes, and remember it
+    // for the next delta. Returns the size, which is just the header if
+    // nothing changed.
+    size_t encode(const uint8_t *frame, uint8_t *out, bool key) {
+        if (key)
+            memset(previous, 0, N);
+        size_t len = 0;
+        out[len++] = key ? frameKey : frameDelta;
+        out[len++] = 0;
+        out[len++] = N & 0xff;
+        out[len++] = N >> 8;
+
+        size_t i = 0;
+        while (i < N) {
+            const size_t from = i;
+            while (i < N && frame[i] == previous[i])
+                i++;
+            if (i == N)
+                break; // the rest is unchanged
+
+            // The literals end at the last change before a long enough run
+            // of unchanged bytes
+            size_t end = i + 1, unchanged = 0;
+            for (size_t j = end; j < N; j++) {
+                if (frame[j] != previous[j])
+                    unchanged = 0, end = j + 1;
+                else if (++unchanged == FRAME_DELTA_MIN_SKIP)
+                    break;
+            }
+            len += varint(out + len, i - from);
+            len += varint(out + len, end - i);
+            for (; i < end; i++) {
+                out[len++] = frame[i] ^ previous[i];
+                previous[i] = frame[i];
+            }
+        }
+        return len;
+    }
+
+  private:
+    uint8_t previous[N] = {};
+
+    static size_t varint(uint8_t *out, size_t value) {
+        size_t n = 0;
+        for (; value >= 0x80; value >>= 7)
+            out[n++] = value | 0x80;
+        out[n++] = value;
+        return n;
+    }
+};
+
+// Apply an encoded frame to the last frame decoded, which must be size bytes.
+// Returns false if the message is malformed, or isn't for a frame this size.
+// After a delta fails, wait for a key frame.
+inline bool frameDecode(const uint8_t *in, size_t length, uint8_t *frame,
+                        size_t size) {
+    if (length < FRAME_DELTA_HEADER || size_t(in[2] | in[3] << 8) != size)
+        return false;
+    if (frameKey == in[0])
+        memset(frame, 0, size);
+    else if (frameDelta != in[0])
+        return false;
+
+    const uint8_t *end = in + length;
+    in += FRAME_DELTA_HEADER;
+    auto varint = [&](size_t &value) {
+        value = 0;
+        for (int shift = 0; in < end && shift < 28; shift += 7) {
+            value |= size_t(*in & 0x7f) << shift;
+            if (!(*in++ & 0x80))
+                return true;
+        }
+        return false;
+    };
+    size_t at = 0, skip, count;
+    while (in < end) {
+        if (!varint(skip) || !varint(count) || size - at < skip ||
+            size - at - skip < count || size_t(end - in) < count)
+            return false;
+        at += skip;
+        for (size_t i = 0; i < count; i++)
+            frame[at++] ^= *in++;
+    }
+    return true;
+}
@@ -0,0 +1,139 @@
+/*
+
+This is a 2D FastLED FX engine effect which draws NoisePalette only on every
+Kth frame, and linearly interpolates the frames in between.
+
+At low speeds the noise field changes very little from one frame to the next,
+so the interpolated frames are almost identical to the real thing, at a
+fraction of the cost. The output lags the noise by K frames.
+
+NoisePalette does two things once per draw rather than by its speed. Presets
+which loop their colours advance the hue by one, so drawn every Kth frame,
+they would cycle K times slower. Those presets are always drawn every frame.
+And it smooths the noise over the last few draws, more at lower speeds,
+which adds a little more lag, but doesn't change how fast the noise moves.
+
+*/
+
+#pragma once
+#include <FastLED.h>
+#include "fl/namespace.h"
+#include "fl/ptr.h"
+#include "fl/scoped_ptr.h"
+#include "fl/xymap.h"
+#include "fx/2d/noisepalette.h"
+#include "fx/fx2d.h"
+#include "blend_bytes.hpp"
+
+namespace fl {
+FASTLED_SMART_PTR(FxKeyframes);
+
+class FxKeyframes : public Fx2d {
+  private:
+    NoisePalette &noise;              // the effect drawn on keyframes
+    uint16_t speed;                   // noise speed per output frame
+    uint8_t interval = 1;             // K, frames per keyframe
+    bool loopsColours = false;        // the preset advances the hue each draw
+    uint8_t frame = 0;                // frames since the previous keyframe
+    bool primed = false;              // true once both keyframes are drawn
+    fl::scoped_array<CRGB> keyframeA; // storage for the previous keyframe
+    fl::scoped_array<CRGB> keyframeB; // storage for the next keyframe
+    CRGB *prev;                       // the previous keyframe
+    CRGB *next;                       // the next keyframe
+    uint32_t µsKey = 0;               // time spent drawing keyframes
+    uint32_t µsInterp = 0;            // time spent interpolating
+    uint16_t interpFrames = 0;        // number of interpolated frames
+    // "<name> keyframe" and "<name> interp" times, once begin() adds them
+    Telemetry::Handle keyHandle = Telemetry::none;
+    Telemetry::Handle interpHandle = Telemetry::none;
+
+    void drawKeyframe(DrawContext &context);
+
+  public:
+    FxKeyframes(XYMap xyMap, NoisePalette &noise, uint16_t speed)
+        : Fx2d(xyMap), noise(noise), speed(speed),
+          keyframeA(new CRGB[xyMap.getTotal()]),
+          keyframeB(new CRGB[xyMap.getTotal()]) {
+        prev = keyframeA.get();
+        next = keyframeB.get();
+    }
+
+    fl::Str fxName() const override { return noise.fxName(); }
+
+    // Report the time taken per frame to telemetry, under this name. Call it
+    // once, after telemetry.begin().
+    void begin(const String &name) {
+        keyHandle = telemetry.add(name + " keyframe",
+                                  {.unit = "ms", .teleplot = ""});
+        interpHandle = telemetry.add(name + " interp",
+                                     {.unit = "ms", .teleplot = ""});
+    }
+
+    // Speed of the noise per frame drawn, as for NoisePalette::setSpeed()
+    void setSpeed(uint16_t value) { speed = value; }
+    // Draw the noise every `frames` frames. 1 disables interpolation.
+    void setInterval(uint8_t frames) { interval = frames ? frames : 1; }
+    // Use one of NoisePalette's presets, and keyframe it if it can be
+    void setPalettePreset(int preset);
+
+    void draw(DrawContext context) override;
+};
+
+// Of NoisePalette's presets, only Forest, Cloud, Lava and Ocean (3 to 6) keep
+// their colours still
+void FxKeyframes::setPalettePreset(int preset) {
+    noise.setPalettePreset(preset);
+    loopsColours = preset < 3 || preset > 6;
+}
+
+// Advance the noise by K frames' worth, and draw it as the next keyframe
+void FxKeyframes::drawKeyframe(DrawContext &context) {
+    CRGB *swap = prev;
+    prev = next, next = swap;
+    noise.setSpeed(speed * interval);
+    DrawContext keyContext = context;
+    keyContext.leds = next;
+    noise.draw(keyContext);
+}
+
+void FxKeyframes::draw(DrawContext context) {
+    if (!context.leds)
+        return;
+    if (interval <= 1 || loopsColours) {
+        noise.setSpeed(speed);
+        noise.draw(context);
+        primed = false;
+        return;
+    }
+    const size_t bytes = getNumLeds() * sizeof(CRGB);
+    uint32_t µs = micros();
+
+    if (!primed) {
+        drawKeyframe(context);
+        drawKeyframe(context);
+        primed = true;
+        frame = 0;
+    } else if (++frame >= interval) {
+        drawKeyframe(context);
+        frame = 0;
+    }
+
+    if (!frame) {
+        memcpy(context.leds, prev, bytes);
+        µsKey = micros() - µs;
+        if (interpFrames) {
+            telemetry.set(keyHandle, µsKey / 1000.f);
+            telemetry.set(interpHandle, µsInterp / (1000.f * interpFrames));
+        }
+        µsInterp = interpFrames = 0;
+        return;
+    }
+
+    memcpy(context.leds, next, bytes);
+    blendBytes((const uint8_t *)prev, (uint8_t *)context.leds, bytes,
+               (frame << 8) / interval);
+    µsInterp += micros() - µs;
+    interpFrames++;
+}
+
+} // namespace fl
@@ -0,0 +1,64 @@
+/*
+
+This is a 2D FastLED FX engine effect which draws whatever a show controller
+sends, over DDP, E1.31 or Art-Net, so FxEngine can crossfade to and from it
+like any other effect.
+
+The controller is expected to send the matrix row by row from the top left,
+as xLights does by default, and the pixels are put in place through the
+XYMap. Set the "stream_remap" preference to false if the controller already
+knows how the LEDs are wired, and its pixels go straight to leds[].
+
+*/
+
+#pragma once
+#include <FastLED.h>
+#include "fl/namespace.h"
+#include "fl/ptr.h"
+#include "fl/scoped_ptr.h"
+#include "fl/xymap.h"
+#include "fx/fx2d.h"
+#include "stream_udp.hpp"
+
+namespace fl {
+FASTLED_SMART_PTR(FxStream);
+
+class FxStream : public Fx2d {
+  private:
+    StreamReceiver<NUM_LEDS> receiver;
+    fl::scoped_array<uint16_t> remap; // leds[] index of each stream pixel
+
+  public:
+    FxStream(XYMap xyMap) : Fx2d(xyMap) {}
+
+    // Start listening, once the network is up
+    void begin();
+    // Whether a show controller is sending frames
+    bool active() const { return receiver.active(); }
+
+    fl::Str fxName() const override { return "Stream"; }
+
+    // Draw the newest frame received. Only ever call this from one task.
+    void draw(DrawContext context) override;
+};
+
+void FxStream::begin() {
+    if (preferences.getBool("stream_remap", true)) {
+        const uint16_t width = mXyMap.getWidth();
+        const uint16_t height = mXyMap.getHeight();
+        remap.reset(new uint16_t[width * height]);
+        for (uint16_t y = 0; y < height; y++)
+            for (uint16_t x = 0; x < width; x++)
+                remap[y * width + x] = mXyMap.mapToIndex(x, height - 1 - y);
+    }
+    receiver.begin(remap.get());
+}
+
+void FxStream::draw(DrawContext context) {
+    if (!context.leds)
+        return;
+    receiver.update();
+    memcpy(context.leds, receiver.front().pixels, getNumLeds() * sizeof(CRGB));
+}
+
+} // namespace fl
@@ -36,9 +36,12 @@ class FxSui : public Fx2d {
     fl::scoped_array<uint8_t> waterB; // temporary buffer for water simulation
     uint8_t edgeDamping;              // affects reflections at the edges
     bool buffer = false;              // used to swap buffers on each frame
-    uint16_t phase[3];                // phase offsets for the moving stimulus
+    uint16_t phase[3] = {};           // phase offsets for the moving stimulus
     uint8_t *buffptr[2];              // pointer to the water buffer
     uint16_t tankPhase = 0;           // phase offset for the wave tank
+    uint32_t lastMs = 0;              // the time of the last frame drawn
+    uint32_t dropWaitMs = 0;          // time until the next random drop
+    uint16_t lastX = 0, lastY = 0;    // where the last random drop fell
 
     // These methods are defined below this Class declaration
     void setPerimeter();
@@ -58,8 +61,8 @@ class FxSui : public Fx2d {
         wwidth = width + 2;
         wheight = height + 2;
         wsize = wwidth * wheight;
-        waterA.reset(new uint8_t[wsize]);
-        waterB.reset(new uint8_t[wsize]);
+        waterA.reset(new uint8_t[wsize]());
+        waterB.reset(new uint8_t[wsize]());
         // flags.movingStimulus = true;
         flags.randomDrops = true;
         swapBuffers();
@@ -80,11 +83,11 @@ class FxSui : public Fx2d {
         bool waveBottom : 1;     // wave generator at the bottom
         bool waveLeft : 1;       // wave generator at the left
     };
-    Flags flags;
+    Flags flags = {};
 
     // More methods are defined below this Class declaration
     void setEdgeDamping(uint8_t value);
-    void waveTank();
+    void waveTank(uint32_t now);
     void draw(DrawContext context) override;
     void wuPixel(uint16_t x, uint16_t y, uint8_t bright);
     CRGB ColorBlend(const TProgmemRGBPalette16 pal, uint16_t index,
@@ -112,7 +115,14 @@ void FxSui::draw(DrawContext context) {
         return;
     }
 
-    waveTank();
+    // Effects are timed by the clock FxEngine gives them, which may run
+    // backwards, so drops are timed by how far it has moved either way
+    const uint32_t now = context.now;
+    const uint32_t elapsed = int32_t(now - lastMs) < 0 ? lastMs - now
+                                                        : now - lastMs;
+    lastMs = now;
+
+    waveTank(now);
 
     // Add a moving stimulus
     if (flags.movingStimulus) {
@@ -129,9 +139,8 @@ void FxSui::draw(DrawContext context) {
 
     // Add random drops
     if (flags.randomDrops) {
-        static uint32_t nextMs = 0; // time of last drop
-        static uint16_t lastX = 0, lastY = 0;
-        if (millis() > nextMs) {
+        dropWaitMs -= elapsed < dropWaitMs ? elapsed : dropWaitMs;
+        if (!dropWaitMs) {
             int x, y, dx, dy, dist, tries = 4;
             do {
                 x = 256 + random16(width * 256);
@@ -142,7 +151,7 @@ void FxSui::draw(DrawContext context) {
             if (tries) {
                 wuPixel(x, y, 255);
                 lastX = x, lastY = y;
-                nextMs = millis() + random8();
+                dropWaitMs = random8();
             }
         }
     }
@@ -176,9 +185,9 @@ void FxSui::setEdgeDamping(uint8_t value) { edgeDamping = value; }
 
 // Wave tank simulation? We'll find out soon enough… Yes! That works.
 // Haha, even beam-forming works. This algorithm is awesome. Thanks, Hugo et al.
-void FxSui::waveTank() {
+void FxSui::waveTank(uint32_t now) {
     tankPhase += 800;
-    uint16_t theta = 327.675f * (1.0f + sin(millis() / 300.f));
+    uint16_t theta = 327.675f * (1.0f + sin(now / 300.f));
 
     // Calculate the length of the perimeter
     uint16_t perimeterLength = 2 * (width + height - 2);
@@ -260,6 +269,8 @@ void FxSui::wuPixel(uint16_t x, uint16_t y, uint8_t bright) {
 void FxSui::advanceWater() {
     uint8_t *src = buffptr[0];
     uint8_t *dst = buffptr[1];
+    // Signed, as -wwidth as a uint32_t only wraps around on a 32-bit CPU
+    const int stride = wwidth;
 
     src += wwidth - 1;
     dst += wwidth - 1;
@@ -270,7 +281,7 @@ void FxSui::advanceWater() {
             // This is slightly different to the Elias algorithm.
             // Rather than negative values clamping at 0, this reflects off 0.
             // It preserves a tiny bit more information in the water buffers.
-            uint16_t t = 64 * (src[-1] + src[1] + src[-wwidth] + src[wwidth]);
+            uint16_t t = 64 * (src[-1] + src[1] + src[-stride] + src[stride]);
             uint16_t bigdst = *dst * 128;
             if (t <= bigdst)
                 *dst = (bigdst - t) >> 8;
@@ -0,0 +1,213 @@
+/*
+
+This is a 2D FastLED FX engine effect which draws another effect at a reduced
+resolution, then bilinearly upscales it to fill the real XYMap.
+
+Smooth effects like NoisePalette look much the same when drawn at half
+resolution, yet cost about a quarter as much, once told they are being drawn
+smaller: NoisePalette::setScale() should be multiplied by the scale factor.
+Effects which can't be told, like Animartrix, draw the middle of their
+pattern enlarged instead, so they are best left at full size.
+
+*/
+
+#pragma once
+#include <FastLED.h>
+#include "fl/namespace.h"
+#include "fl/ptr.h"
+#include "fl/scoped_ptr.h"
+#include "fl/xymap.h"
+#include "fx/fx2d.h"
+
+namespace fl {
+FASTLED_SMART_PTR(FxUpscale);
+
+class FxUpscale : public Fx2d {
+  private:
+    static const uint8_t maxChildren = 4;
+    Fx2d *children[maxChildren];       // the same effect at various sizes
+    uint8_t scales[maxChildren];       // how much smaller each child is
+    uint8_t numChildren = 0;           // number of children added
+    uint8_t current = 0;               // the child being drawn
+    fl::scoped_array<CRGB> small;      // frame buffer for the child
+    uint16_t smallSize = 0;            // size of the frame buffer
+    fl::scoped_array<uint16_t> srcX;   // left source column for each column
+    fl::scoped_array<uint8_t> weightX; // weight of the right source column
+    fl::scoped_array<uint16_t> srcY;   // lower source row for each row
+    fl::scoped_array<uint8_t> weightY; // weight of the upper source row
+
+    void buildWeights(uint16_t size, uint16_t childSize, uint16_t *src,
+                      uint8_t *weight);
+
+  public:
+    FxUpscale(XYMap xyMap) : Fx2d(xyMap) {
+        mXyMap.convertToLookUpTable();
+        srcX.reset(new uint16_t[getWidth()]);
+        weightX.reset(new uint8_t[getWidth()]);
+        srcY.reset(new uint16_t[getHeight()]);
+        weightY.reset(new uint8_t[getHeight()]);
+    }
+
+    fl::Str fxName() const override {
+        return numChildren ? children[current]->fxName() : "upscale";
+    }
+
+    void addChild(Fx2d &child);
+    bool setScale(uint8_t scale);
+    uint8_t getScale() const { return numChildren ? scales[current] : 0; }
+    void draw(DrawContext context) override;
+};
+
+// Add the effect drawn at a smaller size. Its scale is inferred from its width.
+void FxUpscale::addChild(Fx2d &child) {
+    if (numChildren >= maxChildren || !child.getWidth())
+        return;
+    children[numChildren] = &child;
+    scales[numChildren] = getWidth() / child.getWidth();
+    if (child.getNumLeds() > smallSize) {
+        smallSize = child.getNumLeds();
+        small.reset(new CRGB[smallSize]);
+    }
+    if (!numChildren++)
+        setScale(scales[0]);
+}
+
+// Choose which child to draw. This may be changed between any two frames.
+bool FxUpscale::setScale(uint8_t scale) {
+    for (uint8_t i = 0; i < numChildren; i++) {
+        if (scales[i] != scale)
+            continue;
+        current = i;
+        buildWeights(getWidth(), children[i]->getWidth(), srcX.get(),
+                     weightX.get());
+        buildWeights(getHeight(), children[i]->getHeight(), srcY.get(),
+                     weightY.get());
+        return true;
+    }
+    return false;
+}
+
+// Find the source pixels either side of each pixel's centre, and how far
+// between them it falls. Pixels past the last source pixel's centre take it
+// alone, with a weight of 0.
+void FxUpscale::buildWeights(uint16_t size, uint16_t childSize, uint16_t *src,
+                             uint8_t *weight) {
+    for (uint16_t i = 0; i < size; i++) {
+        int32_t pos = ((2 * i + 1) * childSize * 128) / size - 128;
+        if (pos < 0)
+            pos = 0;
+        if (pos > (childSize - 1) * 256)
+            pos = (childSize - 1) * 256;
+        src[i] = pos >> 8;
+        weight[i] = pos & 0xff;
+    }
+}
+
+void FxUpscale::draw(DrawContext context) {
+    if (!numChildren || !context.leds)
+        return;
+    Fx2d *child = children[current];
+    if (scales[current] <= 1) {
+        child->draw(context);
+        return;
+    }
+    CRGB *leds = context.leds;
+    context.leds = small.get();
+    child->draw(context);
+
+    const uint16_t width = getWidth(), height = getHeight();
+    const uint16_t childWidth = child->getWidth();
+    const uint16_t childHeight = child->getHeight();
+    for (uint16_t y = 0; y < height; y++) {
+        uint16_t y0 = srcY[y];
+        uint16_t y1 = y0 + (y0 + 1 < childHeight);
+        uint8_t wy = weightY[y];
+        for (uint16_t x = 0; x < width; x++) {
+            uint16_t x0 = srcX[x];
+            uint16_t x1 = x0 + (x0 + 1 < childWidth);
+            uint8_t wx = weightX[x];
+            const CRGB &p00 = small[child->xyMap(x0, y0)];
+            const CRGB &p10 = small[child->xyMap(x1, y0)];
+            const CRGB &p01 = small[child->xyMap(x0, y1)];
+            const CRGB &p11 = small[child->xyMap(x1, y1)];
+            CRGB &out = leds[xyMap(x, y)];
+            for (uint8_t c = 0; c < 3; c++) {
+                uint8_t lo = lerp8by8(p00.raw[c], p10.raw[c], wx);
+                uint8_t hi = lerp8by8(p01.raw[c], p11.raw[c], wx);
+                out.raw[c] = lerp8by8(lo, hi, wy);
+            }
+        }
+    }
+}
+
+} // namespace fl
+
+// Draw each of our effects at full, half and quarter resolution with a fixed
+// clock, and report the time taken and the PSNR of the upscaled frames.
+void benchmarkUpscale(CRGB *leds) {
+    const int iterations = 20;
+    const uint16_t width = xyMap.getWidth(), height = xyMap.getHeight();
+    const char *names[] = {"Animartrix", "NoisePalette1", "NoisePalette2",
+                           "FxSui"};
+    auto make = [](int which, XYMap map, uint8_t scale) -> Fx2d * {
+        NoisePalette *noise;
+        switch (which) {
+        case 0:
+            return new Animartrix(map, FIRST_ANIMATION);
+        case 1:
+            noise = new NoisePalette(map);
+            noise->setPalettePreset(1);
+            noise->setSpeed(3);
+            noise->setScale(10 * scale);
+            return noise;
+        case 2:
+            noise = new NoisePalette(map);
+            noise->setPalettePreset(4);
+            noise->setScale(30 * scale); // the preset's scale
+            return noise;
+        default:
+            return new FxSui(map);
+        }
+    };
+
+    fl::scoped_array<CRGB> reference(new CRGB[NUM_LEDS]);
+    for (int which = 0; which < 4; which++) {
+        for (uint8_t scale = 2; scale <= 4; scale *= 2) {
+            // Both start from the same random state
+            random16_set_seed(1234);
+            Fx2d *full = make(which, xyMap, 1);
+            random16_set_seed(1234);
+            Fx2d *child = make(
+                which,
+                XYMap::constructRectangularGrid(width / scale, height / scale),
+                scale);
+            FxUpscale upscale(xyMap);
+            upscale.addChild(*child);
+
+            uint32_t now = 0, usFull = 0, usUp = 0;
+            uint64_t sqErr = 0;
+            for (int i = 0; i < iterations; i++) {
+                now += 16;
+                uint32_t us = micros();
+                full->draw(Fx::DrawContext(now, reference.get()));
+                usFull += micros() - us;
+                us = micros();
+                upscale.draw(Fx::DrawContext(now, leds));
+                usUp += micros() - us;
+                for (uint16_t j = 0; j < NUM_LEDS; j++)
+                    for (uint8_t c = 0; c < 3; c++) {
+                        int32_t e = leds[j].raw[c] - reference[j].raw[c];
+                        sqErr += e * e;
+                    }
+            }
+            float mse = sqErr / (3.f * NUM_LEDS * iterations);
+            float psnr = mse ? 10 * log10f(255 * 255 / mse) : INFINITY;
+            Serial.printf(
+                "%s\t%ux\tfull %luus\tupscaled %luus\tPSNR %.1fdB\r\n",
+                names[which], scale, usFull / iterations, usUp / iterations,
+                psnr);
+            delete child;
+            delete full;
+        }
+    }
+}
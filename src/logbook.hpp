@@ -0,0 +1,351 @@
+#pragma once
+#include "mpsc_ring.hpp"
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <esp_app_desc.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <type_traits>
+
+// Structured logs which survive until someone reads them. LOG_WARN("x %d", x)
+// and friends capture the format pointer and up to four arguments into a
+// 64 byte binary record, and queue it without locks or allocation, from any
+// task or ISR. Formatting happens only when the log is read.
+//
+// The telemetry task drains the queue into a RAM history, and prints each
+// record over Serial. If the partition table has a flash partition labelled
+// "logs", the history is also written to it, as a ring of 4 KiB sectors, so
+// logs survive crashes and reboots. Add a line like this to the partitions CSV:
+//   logs, data, 0x99, , 256K,
+// Writing or erasing flash stalls both cores, and the render loop with them,
+// so records are written in batches: half the history at a time, or once a
+// minute, or at once for errors. Each record carries a CRC, so the boot scan
+// skips anything else it finds. /logs?page=n serves them, newest page first.
+//
+// Each call site may log a burst of LOGBOOK_BURST records per second. Records
+// beyond that are counted, and the count is shown on the next record which
+// gets through.
+
+#define LOGBOOK_ARGS 4
+#define LOGBOOK_BURST 5
+#define LOGBOOK_HISTORY 64  // records kept in RAM
+#define LOGBOOK_PAGE 50     // records per /logs page
+#define LOGBOOK_SECTOR 4096 // flash erase size
+// Records written to flash at once, and the longest one waits to be written
+#define LOGBOOK_FLUSH_RECORDS (LOGBOOK_HISTORY / 2)
+#define LOGBOOK_FLUSH_MS 60000
+
+#define LOG_AT(level, ...)                                                     \
+    do {                                                                       \
+        static LogSite logSite;                                                \
+        logbook.write(logSite, level, __VA_ARGS__);                            \
+    } while (0)
+#define LOG_DEBUG(...) LOG_AT(logDebug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(logInfo, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(logWarn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(logError, __VA_ARGS__)
+
+enum LogLevel : uint8_t { logDebug, logInfo, logWarn, logError };
+
+// 64 bytes on the ESP32, so records tile flash sectors
+struct alignas(64) LogRecord {
+    uint32_t sequence;           // increments with each record, ever
+    uint32_t ms;                 // millis() when logged
+    uint32_t build;              // the firmware which logged it
+    const char *format;          // only valid in the same build
+    uint8_t level;               // LogLevel
+    uint8_t argCount;            // arguments in args
+    uint16_t suppressed;         // records rate-limited away before this one
+    uint32_t args[LOGBOOK_ARGS]; // floats by bits, strings by offset in text
+    char text[24];               // copies of string arguments
+    uint32_t crc;                // of everything before it, once numbered
+
+    uint32_t checksum() const {
+        return esp_rom_crc32_le(0, (const uint8_t *)this,
+                                offsetof(LogRecord, crc));
+    }
+};
+
+static_assert(LOGBOOK_SECTOR % sizeof(LogRecord) == 0, "Records straddle");
+
+// The rate limit state of a LOG_...() call site, which tasks on both cores and
+// ISRs may share. A race at the turn of a second may let an extra record
+// through, but never loses count of those suppressed.
+struct LogSite {
+    std::atomic<uint32_t> windowMs{0};   // start of the current second
+    std::atomic<uint32_t> count{0};      // records logged in this window
+    std::atomic<uint32_t> suppressed{0}; // dropped since the last one logged
+
+    bool allow(uint32_t now) {
+        uint32_t window = windowMs.load(std::memory_order_relaxed);
+        if (now - window >= 1000 && windowMs.compare_exchange_strong(
+                                        window, now, std::memory_order_relaxed))
+            count.store(0, std::memory_order_relaxed);
+        if (count.fetch_add(1, std::memory_order_relaxed) < LOGBOOK_BURST)
+            return true;
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+class Logbook {
+  public:
+    uint32_t drops = 0; // records lost because the queue was full
+
+    template <typename... Args>
+    void write(LogSite &site, LogLevel level, const char *format,
+               const Args &...args);
+
+    void begin();
+    template <typename Print> void drain(Print print);
+    void flush();
+    size_t format(const LogRecord &record, char *out, size_t size);
+    String page(uint32_t page);
+
+  private:
+    MpscRing<LogRecord, 32> queue;
+    LogRecord history[LOGBOOK_HISTORY];
+    uint32_t sequence = 1; // of the next record
+    uint32_t build = 0;
+    SemaphoreHandle_t mutex = nullptr; // guards history and flash
+
+    const esp_partition_t *partition = nullptr;
+    uint32_t slots = 0;   // records the partition holds
+    uint32_t next = 0;    // the slot to write next
+    uint32_t flushed = 1; // sequence of the first record not yet in flash
+    uint32_t dueMs = 0;   // when the records waiting must be written
+
+    struct Capture {
+        LogRecord &record;
+        uint8_t used; // bytes of text used
+        void arg(const char *s);
+        void arg(const String &s) { arg(s.c_str()); }
+        void arg(float f) { memcpy(&record.args[record.argCount++], &f, 4); }
+        void arg(double d) { arg(float(d)); }
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value>::type arg(T i) {
+            record.args[record.argCount++] = uint32_t(i);
+        }
+    };
+
+    bool read(uint32_t index, LogRecord &record);
+    void spill();
+};
+
+Logbook logbook;
+
+// Queue a record, unless the call site is over its rate limit
+template <typename... Args>
+void Logbook::write(LogSite &site, LogLevel level, const char *format,
+                    const Args &...args) {
+    static_assert(sizeof...(args) <= LOGBOOK_ARGS, "Too many log arguments");
+    const uint32_t now = millis();
+    if (!site.allow(now))
+        return;
+    const uint32_t suppressed =
+        std::min<uint32_t>(site.suppressed.exchange(0), 0xffff);
+    const bool queued = queue.push([&](LogRecord &record) {
+        record.ms = now;
+        record.format = format;
+        record.level = level;
+        record.argCount = 0;
+        record.suppressed = suppressed;
+        [[maybe_unused]] Capture capture{record, 0};
+        (capture.arg(args), ...);
+    });
+    if (!queued)
+        __atomic_fetch_add(&drops, 1, __ATOMIC_RELAXED);
+}
+
+void Logbook::Capture::arg(const char *s) {
+    record.args[record.argCount++] = used;
+    size_t n = strnlen(s, sizeof(record.text) - 1 - used);
+    memcpy(record.text + used, s, n);
+    record.text[used + n] = 0;
+    used += n + (used + n < sizeof(record.text) - 1);
+}
+
+// Find the flash partition, and where writing left off
+void Logbook::begin() {
+    mutex = xSemaphoreCreateMutex();
+    memcpy(&build, esp_app_get_description()->app_elf_sha256, sizeof(build));
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         ESP_PARTITION_SUBTYPE_ANY, "logs");
+    if (!partition)
+        return;
+    slots = partition->size / LOGBOOK_SECTOR * LOGBOOK_SECTOR /
+            sizeof(LogRecord);
+
+    // Slots which are erased, half written, or anything but a record fail
+    // the CRC. Read a few at a time, as each read of flash is slow.
+    uint32_t newest = 0;
+    LogRecord records[8];
+    for (uint32_t slot = 0; slot < slots; slot += 8) {
+        esp_partition_read(partition, slot * sizeof(LogRecord), records,
+                           sizeof(records));
+        for (uint32_t i = 0; i < 8; i++)
+            if (records[i].crc == records[i].checksum() &&
+                records[i].sequence >= newest)
+                newest = records[i].sequence, next = (slot + i + 1) % slots;
+    }
+    sequence = flushed = newest + 1;
+}
+
+// Number and store queued records, passing each to print(), and write them to
+// flash when a batch is due. The telemetry task calls this.
+template <typename Print> void Logbook::drain(Print print) {
+    LogRecord record;
+    bool urgent = false;
+    while (queue.pop(record)) {
+        if (mutex)
+            xSemaphoreTake(mutex, portMAX_DELAY);
+        if (sequence == flushed)
+            dueMs = millis() + LOGBOOK_FLUSH_MS;
+        LogRecord &stored = history[sequence % LOGBOOK_HISTORY];
+        stored = record;
+        stored.sequence = sequence++;
+        stored.build = build;
+        stored.crc = stored.checksum();
+        urgent |= record.level >= logError;
+        if (sequence - flushed >= LOGBOOK_FLUSH_RECORDS)
+            spill();
+        if (mutex)
+            xSemaphoreGive(mutex);
+        print(stored);
+    }
+    if (sequence != flushed && (urgent || int32_t(millis() - dueMs) >= 0))
+        flush();
+}
+
+// Write any records waiting to flash, as before a restart
+void Logbook::flush() {
+    if (mutex)
+        xSemaphoreTake(mutex, portMAX_DELAY);
+    spill();
+    if (mutex)
+        xSemaphoreGive(mutex);
+}
+
+// Write the records waiting straight from the history, as few runs as the
+// ring and sector boundaries allow. The caller holds the mutex.
+void Logbook::spill() {
+    if (!partition) {
+        flushed = sequence;
+        return;
+    }
+    while (flushed != sequence) {
+        const uint32_t at = next * sizeof(LogRecord);
+        if (0 == at % LOGBOOK_SECTOR)
+            esp_partition_erase_range(partition, at, LOGBOOK_SECTOR);
+        const uint32_t first = flushed % LOGBOOK_HISTORY;
+        uint32_t run = std::min(sequence - flushed, LOGBOOK_HISTORY - first);
+        run = std::min<uint32_t>(
+            run, (LOGBOOK_SECTOR - at % LOGBOOK_SECTOR) / sizeof(LogRecord));
+        esp_partition_write(partition, at, &history[first],
+                            run * sizeof(LogRecord));
+        next = (next + run) % slots;
+        flushed += run;
+    }
+}
+
+// Read the index'th newest record, from RAM if it's waiting to be written or
+// there's no flash. Returns false once there are no older records.
+bool Logbook::read(uint32_t index, LogRecord &record) {
+    const uint32_t waiting = sequence - flushed;
+    if (!partition || index < waiting) {
+        if (index >= LOGBOOK_HISTORY || index + 1 >= sequence)
+            return false;
+        record = history[(sequence - 1 - index) % LOGBOOK_HISTORY];
+        return true;
+    }
+    index -= waiting;
+    if (index >= slots)
+        return false;
+    const uint32_t slot = (next + slots - 1 - index) % slots;
+    esp_partition_read(partition, slot * sizeof(LogRecord), &record,
+                       sizeof(record));
+    return record.crc == record.checksum();
+}
+
+// Format a record as a line of text, like printf would have
+size_t Logbook::format(const LogRecord &record, char *out, size_t size) {
+    static const char levels[] = "DIWE";
+    size_t n = snprintf(out, size, "%lu %lu.%03lu %c ",
+                        (unsigned long)record.sequence,
+                        (unsigned long)record.ms / 1000,
+                        (unsigned long)record.ms % 1000,
+                        levels[record.level & 3]);
+
+    // The format pointer means nothing to another build, so show arguments
+    const bool ours = record.build == build;
+    const char *f = ours ? record.format : "(another build) %x %x %x %x";
+    uint8_t arg = 0;
+    while (*f && n < size - 1) {
+        if ('%' != *f || '%' == f[1]) {
+            out[n++] = *f;
+            f += '%' == *f ? 2 : 1;
+            continue;
+        }
+        // Copy one conversion, like %-8.3f, without length modifiers, as
+        // every argument was stored as 32 bits
+        char spec[16];
+        size_t len = 0;
+        spec[len++] = *f++;
+        for (; *f && strchr("-+ #0123456789.hlzjt", *f); f++)
+            if (!strchr("hlzjt", *f) && len < sizeof(spec) - 2)
+                spec[len++] = *f;
+        char conversion = *f ? *f++ : 'x';
+        if ('p' == conversion)
+            conversion = 'x';
+
+        const uint32_t v = arg < record.argCount ? record.args[arg++] : 0;
+        float real;
+        memcpy(&real, &v, sizeof(real));
+        const bool text = 's' == conversion && ours && v < sizeof(record.text);
+        spec[len++] = 's' == conversion && !text ? 'x' : conversion;
+        spec[len] = 0;
+        char *at = out + n;
+        const size_t room = size - n;
+        if (strchr("fFeEgGaA", conversion))
+            n += snprintf(at, room, spec, double(real));
+        else if (text)
+            n += snprintf(at, room, spec, record.text + v);
+        else if (strchr("dic", conversion))
+            n += snprintf(at, room, spec, int(int32_t(v)));
+        else
+            n += snprintf(at, room, spec, unsigned(v));
+        if (n > size - 1)
+            n = size - 1;
+    }
+    if (record.suppressed && n < size - 1)
+        n += snprintf(out + n, size - n, " (%u suppressed)", record.suppressed);
+    if (n > size - 1)
+        n = size - 1;
+    out[n] = 0;
+    return n;
+}
+
+// A page of logs as text, oldest first. Page 0 is the newest.
+String Logbook::page(uint32_t page) {
+    String text;
+    char line[160];
+    LogRecord record;
+    if (mutex)
+        xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t count = 0;
+    const uint32_t first = page * LOGBOOK_PAGE;
+    while (count < LOGBOOK_PAGE && read(first + count, record))
+        count++;
+    for (uint32_t i = count; i--;) {
+        read(first + i, record);
+        format(record, line, sizeof(line));
+        text += line;
+        text += "\n";
+    }
+    if (mutex)
+        xSemaphoreGive(mutex);
+    if (!count)
+        text = "No logs\n";
+    return text;
+}
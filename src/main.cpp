@@ -16,6 +16,9 @@
 #define PANEL_WIDTH 16
 #define PANEL_HEIGHT 16
 #define XY_CONFIG (xySerpentine | xyColumnMajor | xySerpentineTiling)
+#define NUM_PANELS                                                             \
+    ((MATRIX_WIDTH / PANEL_WIDTH) * (MATRIX_HEIGHT / PANEL_HEIGHT))
+#define NUM_OUTPUTS 4 // data pins available for parallel output
 
 #define FIRST_ANIMATION RGB_BLOBS5
 
@@ -32,37 +35,74 @@ UINumberField fxIndex("Animartrix index", FIRST_ANIMATION, 0,
                       NUM_ANIMATIONS - 1);
 UISlider timeSpeed("Time Speed", 2, -10, 10, .1);
 UICheckbox switchFx("Switch Fx", true);
+UICheckbox freezeFx("Freeze outgoing Fx", true);
+UISlider prewarmMs("Pre-warm ms", 1000, 0, 4000, 100);
+UISlider noiseInterval("Noise keyframe interval", 4, 1, 8, 1);
+UISlider noiseUpscale("Noise upscale", 1, 1, 2, 1);
 
 Animartrix animartrix(xyMap, FIRST_ANIMATION);
+// The first noise may also be drawn at half resolution and upscaled
+XYMap halfXyMap =
+    XYMap::constructRectangularGrid(MATRIX_WIDTH / 2, MATRIX_HEIGHT / 2);
 NoisePalette noisePalette1(xyMap);
+NoisePalette noisePalette1Half(halfXyMap);
 NoisePalette noisePalette2(xyMap);
+FxKeyframes noiseKeyframes1(xyMap, noisePalette1, 3);
+FxKeyframes noiseKeyframes1Half(halfXyMap, noisePalette1Half, 3);
+FxKeyframes noiseKeyframes2(xyMap, noisePalette2, 4); // CloudColors preset
+FxUpscale noiseUpscale1(xyMap);
 FxSui fxSui(xyMap);
+FxStream fxStream(xyMap);
 FxEngine fxEngine(NUM_LEDS);
+Crossfader crossfader(fxEngine, NUM_LEDS);
+Prewarmer prewarmer(fxEngine, NUM_LEDS);
 
 LD2450 ld2450;
+int streamFxId = -1; // FxEngine's id for fxStream, the last effect added
+int noise1FxId = -1, noise2FxId = -1; // and for the noises, for settings
+
+OutputPlan outputPlan; // which LEDs each data pin drives
+
+Telemetry::Handle drawTelemetry, showTelemetry, nonFastLEDTelemetry,
+    fpsTelemetry, frameP99Telemetry, fxIdTelemetry, animartrixTelemetry;
+
+// Attach a slice of leds[] to a data pin, if the planner gave it any LEDs
+template <uint8_t PIN> void addStrip(const OutputStrip &strip) {
+    if (strip.count)
+        FastLED.addLeds<WS2812, PIN, GRB>(leds, strip.offset, strip.count);
+}
 
 void setup() {
     preferencesBegin();
     telemetry.begin();
     Serial.begin(preferences.getUInt("baudrate", 115200));
     Serial2.begin(LD2450_SERIAL_SPEED, SERIAL_8N1, 16, 17);
-    ld2450.begin(Serial2, true);
     setupWiFi();
     setupWebServer();
+    radarLink.begin();
+    fxStream.begin();
 
     // 4 x 256 LEDs in 16x16 serpentine with LED0 in bottom left and LED1 above
-    // it
-    FastLED.addLeds<WS2812, 14, GRB>(leds, NUM_LEDS / 4);
-    FastLED.addLeds<WS2812, 13, GRB>(leds, NUM_LEDS / 4, NUM_LEDS / 4);
-    FastLED.addLeds<WS2812, 12, GRB>(leds, NUM_LEDS / 2, NUM_LEDS / 4);
-    FastLED.addLeds<WS2812, 11, GRB>(leds, NUM_LEDS * 3 / 4, NUM_LEDS / 4);
+    // it. Split the panels between the pins so the longest strip is shortest.
+    static_assert(NUM_OUTPUTS <= 4, "add an addStrip() for each extra pin");
+    outputPlan =
+        planOutputs(NUM_PANELS, PANEL_WIDTH * PANEL_HEIGHT, NUM_OUTPUTS);
+    const OutputPlan &plan = outputPlan;
+    addStrip<14>(plan.strips[0]);
+    addStrip<13>(plan.strips[1]);
+    addStrip<12>(plan.strips[2]);
+    addStrip<11>(plan.strips[3]);
     // FastLED.addLeds<WS2812, 48, GRB>(leds, NUM_LEDS, 1);
 
     fxEngine.addFx(animartrix);
-    fxEngine.addFx(noisePalette1);
-    fxEngine.addFx(noisePalette2);
+    noiseUpscale1.addChild(noiseKeyframes1);
+    noiseUpscale1.addChild(noiseKeyframes1Half);
+    noise1FxId = fxEngine.addFx(noiseUpscale1);
+    noise2FxId = fxEngine.addFx(noiseKeyframes2);
     fxEngine.addFx(fxSui);
+    streamFxId = fxEngine.addFx(fxStream);
     fxSui.setEdgeDamping(255);
+    prewarmer.begin();
     // fxSui.setMovingStimulus(false);
     // fxSui.setRandomDrops(false);
     // fxSui.setRandomDropsRate(0);
@@ -70,50 +110,184 @@ void setup() {
     // fxSui.setWaveTankRate(0);
     // fxSui.setWaveTankSpeed(0);
 
-    noisePalette1.setPalettePreset(1);
-    noisePalette1.setSpeed(3);
+    // The noise speed is set by FxKeyframes, scaled by the keyframe interval.
+    // The first preset loops its colours, so it is never keyframed, but it
+    // can be upscaled instead.
+    noiseKeyframes1.setPalettePreset(1);
     noisePalette1.setScale(10);
-    noisePalette2.setPalettePreset(4);
+    noiseKeyframes1Half.setPalettePreset(1);
+    noisePalette1Half.setScale(10 * 2);
+    noiseKeyframes2.setPalettePreset(4);
+    noiseKeyframes1.begin("noise1");
+    noiseKeyframes1Half.begin("noise1 half");
+    noiseKeyframes2.begin("noise2");
 
     // benchmarkXYmaps();
+    // benchmarkBlend();
+    // benchmarkUpscale(leds);
+    // benchmarkEffects(leds);
+    // benchmarkRadar(leds);
 
-    // Confirm if radar reports are being received
-    if (ld2450.read() < 4)
-        Serial.printf("LD2450 radar active");
+    // Parse the local sensor (or a capture of it), unless a remote radar
+    // node is sending us its reports
+    if (radarReceiver != radarLink.role) {
+        ld2450.begin(radarSource(Serial2));
+        // Confirm if radar reports are being received
+        if (ld2450.read() < 4)
+            Serial.printf("LD2450 radar active");
+        radarBegin(ld2450, Serial2);
+    }
 
     // Set custom parameters for some telemetry data points
-    telemetry.add("draw", {.minMs = 100, .unit = "ms", .teleplot = ""});
-    telemetry.add("show", {.minMs = 100, .unit = "ms", .teleplot = ""});
-    telemetry.add("nonFastLED", {.minMs = 100, .unit = "ms", .teleplot = ""});
-    telemetry.add("fps", {.minMs = 100, .unit = "Hz", .teleplot = ""});
+    // Timings are sampled 20 times a second, and sent each second as the
+    // mean, min, max and count of the samples, so brief spikes still show
+    Telemetry::Datum timing = {
+        .minMs = 1000, .unit = "ms", .teleplot = "", .aggregate = true};
+    drawTelemetry = telemetry.add("draw", timing);
+    showTelemetry = telemetry.add("show", timing);
+    nonFastLEDTelemetry = telemetry.add("nonFastLED", timing);
+    timing.unit = "Hz";
+    timing.priority = Telemetry::critical;
+    fpsTelemetry = telemetry.add("fps", timing);
+    frameP99Telemetry = telemetry.add("frame p99",
+                                      {.unit = "ms",
+                                       .teleplot = "",
+                                       .deadband = .05f,
+                                       .priority = Telemetry::critical});
+
+    fxIdTelemetry = telemetry.add("FxId", Telemetry::Datum{});
+    animartrixTelemetry = telemetry.add("AnimartrixFx", Telemetry::Datum{});
+
+    // Predicted show() time, to compare against the measured "show"
+    telemetry.add("show model", {.value = String(plan.showUs / 1000.f),
+                                 .unit = "ms",
+                                 .teleplot = ""});
+}
+
+// The effect after the current one, leaving out fxStream, which is only shown
+// while a show controller is sending
+int nextFxId() {
+    const int next = fxEngine.getCurrentFxId() + 1;
+    return next < streamFxId ? next : 0;
 }
 
 void draw() {
     // Apply any changed settings from the UI
     FastLED.setBrightness(brightness);
     fxEngine.setSpeed(timeSpeed);
+    crossfader.freeze = freezeFx;
+
+    // Change the noises' settings only when the sliders move, and not while
+    // the other core pre-warms that noise, as its draw() uses them
+    static uint8_t interval1 = 0, interval2 = 0; // as last set
+    const uint8_t interval = noiseInterval;
+    if (!prewarmer.warming(noise1FxId)) {
+        if (interval != interval1) {
+            noiseKeyframes1.setInterval(interval);
+            noiseKeyframes1Half.setInterval(interval);
+            interval1 = interval;
+        }
+        if (uint8_t(noiseUpscale) != noiseUpscale1.getScale())
+            noiseUpscale1.setScale(noiseUpscale);
+    }
+    if (!prewarmer.warming(noise2FxId) && interval != interval2) {
+        noiseKeyframes2.setInterval(interval);
+        interval2 = interval;
+    }
 
-    // Crossfade to a different effect
-    EVERY_N_SECONDS(8) {
-        if (switchFx) {
-            fxEngine.nextFx(2000);
-            const auto fxId = fxEngine.getCurrentFxId();
-            telemetry.add("FxId", String(fxId));
+    // Crossfade to a show controller's frames while it sends them, then back
+    // to the effect it interrupted
+    static uint32_t switchMs = millis() + 8000;
+    static int resumeFxId = -1; // the effect to return to, while streaming
+    if (fxStream.active() != (resumeFxId >= 0)) {
+        prewarmer.stop();
+        if (resumeFxId < 0) {
+            resumeFxId = fxEngine.getCurrentFxId();
+            crossfader.to(streamFxId, 500);
+            telemetry.set(fxIdTelemetry, streamFxId);
+        } else {
+            crossfader.to(resumeFxId, 2000);
+            telemetry.set(fxIdTelemetry, resumeFxId);
+            resumeFxId = -1;
+        }
+        switchMs = millis() + 8000;
+    }
+
+    // Warm up the next effect on the other core, then crossfade to it
+    const bool rotate = switchFx && resumeFxId < 0;
+    const uint32_t leadMs = prewarmMs.value();
+    if (rotate && leadMs && int32_t(millis() + leadMs - switchMs) >= 0)
+        prewarmer.start(nextFxId());
+    if (int32_t(millis() - switchMs) >= 0) {
+        switchMs += 8000;
+        prewarmer.stop();
+        if (rotate) {
+            const int fxId = nextFxId();
+            crossfader.to(fxId, 2000);
+            telemetry.set(fxIdTelemetry, fxId);
             if (2 == fxId) {
                 animartrix.fxNext();
-                telemetry.add("AnimartrixFx", String(animartrix.fxGet()));
+                telemetry.set(animartrixTelemetry, animartrix.fxGet());
             }
         }
     }
 
     // Draw the current effect
-    fxEngine.draw(millis(), leds);
+    const uint32_t now = millis();
+    prewarmer.follow(now, timeSpeed);
+    crossfader.draw(now, leds);
 
     // onboard LED
     leds[NUM_LEDS] = CHSV(millis() / 16, 255, 128);
 
-    // show the speed of any detected radar targets
-    radar(leds, xyMap, ld2450);
+    // show the speed of any detected radar targets, unless a show controller
+    // owns the matrix
+    if (resumeFxId < 0)
+        radar(leds, xyMap);
+}
+
+// Report the 99th percentile time between loop() starts every 5 seconds,
+// which catches occasional stalls that the averages above hide
+void frameTime() {
+    const int buckets = 64; // 0.5ms each, the last for anything longer
+    static uint16_t histogram[buckets];
+    static uint32_t frames = 0;   // frames in the histogram
+    static uint32_t µsLast = 0;   // start of the previous loop()
+    static uint32_t msReport = 0; // when the histogram was last reported
+
+    const uint32_t µsNow = micros();
+    if (µsLast) {
+        const uint32_t bucket = (µsNow - µsLast) / 500;
+        histogram[bucket < buckets ? bucket : buckets - 1]++;
+        frames++;
+    }
+    µsLast = µsNow;
+
+    if (millis() - msReport < 5000)
+        return;
+    msReport = millis();
+    uint32_t count = histogram[0];
+    int bucket = 0;
+    while (bucket < buckets - 1 && count * 100 < frames * 99)
+        count += histogram[++bucket];
+    if (frames)
+        telemetry.set(frameP99Telemetry, (bucket + 1) * .5f);
+    memset(histogram, 0, sizeof(histogram));
+    frames = 0;
+}
+
+// Once booting has settled, warn if show() doesn't take as long as the output
+// plan predicts, as then the predictions the panels were split by are wrong
+void checkShowModel(float showUs, float frameUs) {
+    static bool checked = false;
+    if (checked || millis() < 10000)
+        return;
+    checked = true;
+    const ShowCheck check = checkShow(outputPlan, showUs, frameUs);
+    if (showAsPlanned != check)
+        LOG_WARN("show() took %.0fus in %.0fus frames, but %.0fus was "
+                 "predicted",
+                 showUs, frameUs, outputPlan.showUs);
 }
 
 void loop() {
@@ -123,6 +297,7 @@ void loop() {
     static uint32_t µsSamples = 0; // number of samples taken
     if (!µsStart)
         µsStart = micros();
+    frameTime();
 
     // Draw the effects
     µsDraw -= micros();
@@ -134,35 +309,49 @@ void loop() {
     FastLED.show();
     µsShow += micros();
 
+    // Stream the frame to any browsers showing the preview
+    preview.update(leds);
+
     // Handle OTA updates
     ElegantOTA.loop();
 
     // And our own ability to reboot (to test preferences and stuff)
     if (flags.restartPending) {
         preferences.end();
+        logbook.flush();
         ESP.restart();
     }
 
+    // Benchmark the effects on request from the web page
+    if (flags.benchmarkPending) {
+        flags.benchmarkPending = false;
+        benchmarkEffects(leds);
+        benchmarkRadar(leds);
+        benchmarkTelemetry();
+    }
+
     if (flags.doConnectActions) {
         flags.doConnectActions = false;
         // It might be useful for effects to know when WiFi connects...
     }
 
-    // Gather loop() timing data at most 5 times per second
+    // Gather loop() timing data at most 20 times per second
     µsSamples++;
     uint64_t µsElapsed = micros() - µsStart;
-    if (µsElapsed >= 200000) {
+    if (µsElapsed >= 50000) {
         float divisor = 1000.f * µsSamples;
         uint64_t µsNonFastLED = µsElapsed - µsDraw - µsShow;
-        telemetry.add("draw", String(µsDraw / divisor));
-        telemetry.add("show", String(µsShow / divisor));
-        telemetry.add("nonFastLED", String(µsNonFastLED / divisor));
-        telemetry.add("fps", String(µsSamples * 1000000.f / µsElapsed));
+        telemetry.set(drawTelemetry, µsDraw / divisor);
+        telemetry.set(showTelemetry, µsShow / divisor);
+        telemetry.set(nonFastLEDTelemetry, µsNonFastLED / divisor);
+        telemetry.set(fpsTelemetry, µsSamples * 1000000.f / µsElapsed);
+        checkShowModel(float(µsShow) / µsSamples, float(µsElapsed) / µsSamples);
         µsSamples = µsShow = µsDraw = µsStart = 0;
 
         // Gather RAM usage, uptime, and WiFi signal data
         telemetry.sysStats();
+        radarLink.report();
     }
-    // Send telemetry that has changed
+    // Send telemetry that has changed, unless the telemetry task does
     telemetry.send();
 }
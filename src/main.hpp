@@ -16,6 +16,8 @@
 #include "LD2450.h"
 #include "XY.hpp"
 #include "fxSui.hpp"
+#include "fxUpscale.hpp"
+#include "outputs.hpp"
 #include "preferences.hpp"
 #include "radar.hpp"
 
@@ -23,6 +25,15 @@
 #include "telemetry.hpp"
 Telemetry telemetry;
 
+#include "benchmark.hpp"
+#include "crossfade.hpp"
+#include "fxKeyframes.hpp"
+#include "fxStream.hpp"
+#include "preview.hpp"
+#include "prewarm.hpp"
+#include "radar_capture.hpp"
+#include "radar_udp.hpp"
+
 #include "web_pages.hpp"
 #include "wifi.hpp"
 
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// A bounded queue of T which any number of tasks or ISRs may push() to, and
+// one task pop()s from, without locks or allocation. Each cell carries a
+// sequence number which says whether it is free for the push at a position,
+// or holds the value for the pop at a position (Dmitry Vyukov's design). A
+// push only fails if the queue is full; it never waits for the consumer.
+template <typename T, uint32_t N> class MpscRing {
+    static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+
+  public:
+    MpscRing() {
+        for (uint32_t i = 0; i < N; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Any task or ISR: claim the next free cell, fill it, then publish it
+    template <typename Fill> bool push(Fill fill) {
+        uint32_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & (N - 1)];
+            int32_t diff =
+                cell.sequence.load(std::memory_order_acquire) - pos;
+            if (diff < 0)
+                return false; // full
+            if (!diff && head.compare_exchange_weak(
+                             pos, pos + 1, std::memory_order_relaxed))
+                break;
+            if (diff)
+                pos = head.load(std::memory_order_relaxed);
+        }
+        Cell &cell = cells[pos & (N - 1)];
+        fill(cell.value);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool push(const T &value) {
+        return push([&](T &cell) { cell = value; });
+    }
+
+    // The consumer: take the oldest value. Returns false if the queue is
+    // empty, or the oldest value is still being filled.
+    bool pop(T &value) {
+        Cell &cell = cells[tail & (N - 1)];
+        if (int32_t(cell.sequence.load(std::memory_order_acquire) -
+                    (tail + 1)))
+            return false;
+        value = cell.value;
+        cell.sequence.store(tail + N, std::memory_order_release);
+        tail++;
+        return true;
+    }
+
+  private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T value;
+    };
+    Cell cells[N];
+    std::atomic<uint32_t> head{0}; // next position to push to
+    uint32_t tail = 0;             // next position to pop, only the consumer
+};
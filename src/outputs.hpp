@@ -0,0 +1,180 @@
+#pragma once
+#include <stdint.h>
+
+// With parallel output, show() takes as long as the longest strip. Split the
+// panels between the available data pins so that the longest strip is as short
+// as possible, without ever splitting a panel across two pins.
+
+#if defined(FASTLED_OVERCLOCK)
+#define OUTPUT_OVERCLOCK FASTLED_OVERCLOCK
+#else
+#define OUTPUT_OVERCLOCK 1.0
+#endif
+
+// Nominal WS2812 bit timings in ns, as used by FastLED's clockless drivers
+#if defined(FASTLED_WS2812_T1)
+#define OUTPUT_WS2812_T1 FASTLED_WS2812_T1
+#else
+#define OUTPUT_WS2812_T1 250
+#endif
+#if defined(FASTLED_WS2812_T2)
+#define OUTPUT_WS2812_T2 FASTLED_WS2812_T2
+#else
+#define OUTPUT_WS2812_T2 625
+#endif
+#if defined(FASTLED_WS2812_T3)
+#define OUTPUT_WS2812_T3 FASTLED_WS2812_T3
+#else
+#define OUTPUT_WS2812_T3 375
+#endif
+
+#define OUTPUT_MAX_STRIPS 8
+
+// Predicts how long it takes to clock a frame out to a strip of WS2812s
+struct WS2812Timing {
+    float t1Ns = OUTPUT_WS2812_T1;      // high time common to 0 and 1 bits
+    float t2Ns = OUTPUT_WS2812_T2;      // extra high time for 1 bits
+    float t3Ns = OUTPUT_WS2812_T3;      // low time
+    float overclock = OUTPUT_OVERCLOCK; // FastLED divides T1-T3 by this
+    uint32_t latchUs = 280;             // reset/latch gap between frames
+    uint32_t overheadUs = 0;            // fixed cost of show(), if measured
+
+    // Duration of one bit on the wire
+    float bitNs() const { return (t1Ns + t2Ns + t3Ns) / overclock; }
+
+    // Duration of one whole frame for a strip of this many LEDs
+    float stripUs(uint32_t leds) const {
+        return leds * 24 * bitNs() / 1000.f + latchUs + overheadUs;
+    }
+};
+
+// A contiguous slice of leds[] driven by a single data pin
+struct OutputStrip {
+    uint16_t offset = 0; // first LED in leds[]
+    uint16_t count = 0;  // number of LEDs, 0 if this pin is unused
+};
+
+// The result of planning: one slice per pin, and the predicted show() time
+struct OutputPlan {
+    OutputStrip strips[OUTPUT_MAX_STRIPS];
+    uint8_t numStrips = 0; // number of pins with LEDs attached
+    uint16_t longest = 0;  // LEDs in the longest strip
+    float showUs = 0;      // predicted time for show()
+};
+
+// Greedily fill strips of up to `capacity` LEDs with whole panels. Returns
+// the number of strips needed.
+uint8_t fillOutputs(const uint16_t *panelLeds, uint16_t numPanels,
+                    uint32_t capacity, OutputPlan *plan = nullptr) {
+    uint8_t strips = 0;
+    uint32_t offset = 0, count = 0;
+    for (uint16_t i = 0; i < numPanels; i++) {
+        if (panelLeds[i] > capacity)
+            return 255;
+        if (count + panelLeds[i] > capacity) {
+            if (plan && strips < OUTPUT_MAX_STRIPS)
+                plan->strips[strips] = {uint16_t(offset), uint16_t(count)};
+            strips++;
+            offset += count, count = 0;
+        }
+        count += panelLeds[i];
+    }
+    if (count) {
+        if (plan && strips < OUTPUT_MAX_STRIPS)
+            plan->strips[strips] = {uint16_t(offset), uint16_t(count)};
+        strips++;
+    }
+    return strips;
+}
+
+/**
+ * @brief Split panels between data pins to minimise the longest strip.
+ *
+ * @param panelLeds Number of LEDs on each panel, in wiring order.
+ * @param numPanels Number of panels.
+ * @param numPins Number of data pins available for parallel output.
+ * @param timing WS2812 timing model used to predict the show() time.
+ * @return OutputPlan The slice of leds[] for each pin. Unused pins have a
+ * count of 0.
+ */
+OutputPlan planOutputs(const uint16_t *panelLeds, uint16_t numPanels,
+                       uint8_t numPins,
+                       const WS2812Timing &timing = WS2812Timing()) {
+    OutputPlan plan;
+    if (numPins > OUTPUT_MAX_STRIPS)
+        numPins = OUTPUT_MAX_STRIPS;
+    if (!numPanels || !numPins)
+        return plan;
+
+    // Binary search for the smallest capacity that fits in numPins strips
+    uint32_t lo = 0, hi = 0;
+    for (uint16_t i = 0; i < numPanels; i++) {
+        hi += panelLeds[i];
+        if (panelLeds[i] > lo)
+            lo = panelLeds[i];
+    }
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (fillOutputs(panelLeds, numPanels, mid) <= numPins)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    plan.numStrips = fillOutputs(panelLeds, numPanels, lo, &plan);
+    for (uint8_t i = 0; i < plan.numStrips; i++)
+        if (plan.strips[i].count > plan.longest)
+            plan.longest = plan.strips[i].count;
+    plan.showUs = timing.stripUs(plan.longest);
+    return plan;
+}
+
+// Plan for a matrix of identical panels, as laid out by XY_panels(). The
+// fewest panels per pin that fit is the number of panels over the number of
+// pins, rounded up, which is what the binary search above would find.
+OutputPlan planOutputs(uint16_t numPanels, uint16_t ledsPerPanel,
+                       uint8_t numPins,
+                       const WS2812Timing &timing = WS2812Timing()) {
+    OutputPlan plan;
+    if (numPins > OUTPUT_MAX_STRIPS)
+        numPins = OUTPUT_MAX_STRIPS;
+    if (!numPanels || !numPins || !ledsPerPanel)
+        return plan;
+
+    const uint16_t perStrip = (numPanels + numPins - 1) / numPins;
+    for (uint16_t first = 0; first < numPanels; first += perStrip) {
+        const uint16_t panels =
+            numPanels - first < perStrip ? numPanels - first : perStrip;
+        plan.strips[plan.numStrips++] = {uint16_t(first * ledsPerPanel),
+                                         uint16_t(panels * ledsPerPanel)};
+    }
+    plan.longest = perStrip * ledsPerPanel;
+    plan.showUs = timing.stripUs(plan.longest);
+    return plan;
+}
+
+// How the measured show() compares with the plan
+enum ShowCheck : uint8_t { showAsPlanned, showSlower, showFaster };
+
+/**
+ * @brief Check the plan's prediction against show() as measured.
+ *
+ * show() hands the frame to the hardware after waiting for the last one to
+ * finish being sent, so it should never take much longer than the predicted
+ * showUs, and frames can't be sent faster than one per showUs.
+ *
+ * @param showUs Mean time spent in show(), per frame.
+ * @param frameUs Mean time between frames.
+ * @param tolerance Fraction of showUs the measurements may be out by.
+ * @return ShowCheck showSlower if show() takes too long, for instance if the
+ * timings are wrong or the pins aren't driven in parallel. showFaster if
+ * frames come too quickly, so the timings or the overclock are too slow.
+ */
+ShowCheck checkShow(const OutputPlan &plan, float showUs, float frameUs,
+                    float tolerance = .25f) {
+    if (showUs > plan.showUs * (1 + tolerance))
+        return showSlower;
+    if (frameUs < plan.showUs * (1 - tolerance))
+        return showFaster;
+    return showAsPlanned;
+}
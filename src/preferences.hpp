@@ -9,9 +9,11 @@ struct Flags {
     bool firstConnect : 1;     // false until the first WiFi connect
     bool doConnectActions : 1; // true each time WiFi connects
     bool restartPending : 1;   // signals the firmware to reboot (not for OTA)
+    bool benchmarkPending : 1; // signals loop() to run the benchmarks
     bool wifiConnected : 1;    // true when WiFi is connected
     bool serialTelemetry : 1;  // enable serial telemetry
     bool udpTelemetry : 1;     // enable UDP telemetry
+    bool binaryTelemetry : 1;  // send UDP telemetry in binary, for the bridge
 } flags;
 
 // Edit this function to set your preferences, upload, then undo the edit.
@@ -32,6 +34,24 @@ void storePreferences() {
     preferences.putBool("udpTelemetry", true);     // send stats via UDP
     preferences.putUInt("telemetry_port", 47269);  // port your PC listens on
     preferences.putString("telemetry_host", "your_pc_ip_address");
+    preferences.putBool("binaryTelemetry", false); // via tools/teleplot_bridge
+    preferences.putUInt("telemetry_bps", 20000);   // most UDP bytes/s to send
+    preferences.putUInt("history_kib", 2048);      // PSRAM for /history
+    preferences.putUInt("preview_fps", 10); // web preview frame rate, 0: off
+    preferences.putUChar("radar_capture", 0); // 1: to flash, 2: via UDP
+    preferences.putUInt("radar_capture_port", 47270); // on telemetry_host
+    preferences.putBool("radar_replay", false); // replay the flash capture
+    preferences.putUChar("radar_role", 0); // 1: send reports, 2: receive them
+    preferences.putString("radar_peer", "receiver_ip_address"); // for sending
+    preferences.putUInt("radar_port", 47271);
+    preferences.putUInt("stream_ddp_port", 4048);     // 0 ignores DDP
+    preferences.putUInt("stream_e131_port", 5568);    // 0 ignores E1.31
+    preferences.putUInt("stream_artnet_port", 6454);  // 0 ignores Art-Net
+    preferences.putUInt("stream_universe", 1);        // E1.31's first universe
+    preferences.putUInt("stream_artnet_universe", 0); // Art-Net's first
+    preferences.putUInt("stream_channels", 510);      // per universe
+    preferences.putUInt("stream_timeout", 2500); // ms until back to effects
+    preferences.putBool("stream_remap", true); // rows from top left, via XYMap
 
     // Find the string for your timezone here:
     //   https://github.com/nayarsystems/posix_tz_db/blob/master/zones.csv
@@ -52,4 +72,5 @@ void preferencesBegin() {
     storePreferences();
     flags.serialTelemetry = preferences.getBool("serialTelemetry", true);
     flags.udpTelemetry = preferences.getBool("udpTelemetry", false);
+    flags.binaryTelemetry = preferences.getBool("binaryTelemetry", false);
 }
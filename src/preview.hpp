@@ -0,0 +1,93 @@
+#pragma once
+#include "frame_delta.hpp"
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+
+// Streams leds[] to browsers over a WebSocket at /preview, so the index page
+// can show what the matrix is showing without going to look at it. Each
+// browser is sent the XYMap as JSON when it connects, then frames compressed
+// by frame_delta.hpp, at up to the "preview_fps" preference (0 turns it off).
+//
+// Frames are hardly queued: if any browser has WS_MAX_QUEUED_MESSAGES
+// messages waiting, which platformio.ini sets to 4, the frame is dropped and
+// counted, so the preview is only a few frames late. Every browser gets the
+// same stream, so a new one asks for a key frame.
+class Preview {
+  public:
+    void begin(AsyncWebServer &server, XYMap &xyMap);
+    void update(const CRGB *leds);
+
+  private:
+    static const uint16_t frameSize = NUM_LEDS * sizeof(CRGB);
+    AsyncWebSocket socket{"/preview"};
+    FrameEncoder<frameSize> encoder;
+    uint8_t message[FrameEncoder<frameSize>::maxSize];
+    XYMap *xyMap = nullptr;
+    uint32_t frameMs = 0; // 0 if the preview is off
+    uint32_t sentMs = 0;
+    uint32_t drops = 0;                 // frames dropped for slow browsers
+    std::atomic<bool> keyPending{true}; // set when a browser connects
+    Telemetry::Handle bytesHandle, dropsHandle;
+
+    String geometry();
+};
+
+Preview preview;
+
+void Preview::begin(AsyncWebServer &server, XYMap &map) {
+    xyMap = &map;
+    const uint32_t fps = preferences.getUInt("preview_fps", 10);
+    if (!fps)
+        return;
+    frameMs = 1000 / fps;
+    socket.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client,
+                          AwsEventType type, void *, uint8_t *, size_t) {
+        if (WS_EVT_CONNECT != type)
+            return;
+        client->text(geometry());
+        keyPending = true;
+    });
+    server.addHandler(&socket);
+    bytesHandle = telemetry.add(
+        "Preview", {.unit = "B", .teleplot = "", .aggregate = true});
+    dropsHandle = telemetry.add("Preview drops", {.maxMs = 600000});
+}
+
+// Send a frame, if one is due and every browser is ready for it
+void Preview::update(const CRGB *leds) {
+    if (!frameMs || millis() - sentMs < frameMs)
+        return;
+    sentMs = millis();
+    socket.cleanupClients();
+    if (!socket.count())
+        return;
+    // The clients belong to the async_tcp task, so only ask the socket, which
+    // takes its lock, rather than looking at them from here
+    if (!socket.availableForWriteAll()) {
+        telemetry.set(dropsHandle, ++drops);
+        return;
+    }
+
+    const bool key = keyPending.exchange(false);
+    const size_t size = encoder.encode((const uint8_t *)leds, message, key);
+    if (key || size > FRAME_DELTA_HEADER) // unchanged frames aren't sent
+        socket.binaryAll(message, size);
+    telemetry.set(bytesHandle, size);
+}
+
+// The size of the matrix, and the index in leds[] of each pixel, row by row
+String Preview::geometry() {
+    const uint16_t width = xyMap->getWidth(), height = xyMap->getHeight();
+    String json;
+    json.reserve(32 + width * height * 5);
+    json += "{\"width\":" + String(width) + ",\"height\":" + String(height) +
+            ",\"map\":[";
+    for (uint16_t y = 0; y < height; y++)
+        for (uint16_t x = 0; x < width; x++) {
+            if (x || y)
+                json += ',';
+            json += String(xyMap->mapToIndex(x, y));
+        }
+    json += "]}";
+    return json;
+}
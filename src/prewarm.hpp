@@ -0,0 +1,123 @@
+#pragma once
+#include <FastLED.h>
+#include "fl/scoped_ptr.h"
+#include "fx/fx_engine.h"
+#include <atomic>
+
+using namespace fl;
+
+// Effects start cold: FxSui's water is flat and Animartrix builds its state on
+// the first draw. Advance the next effect on the other core for a while before
+// it is crossfaded in, so the transition starts from a steady-state frame.
+//
+// FxEngine gives effects its own clock, which runs at its speed from when it
+// was constructed. follow() keeps a copy of that clock, so the effect is
+// pre-warmed at the times FxEngine would have drawn it.
+class Prewarmer {
+  public:
+    Prewarmer(FxEngine &engine, uint16_t numLeds)
+        : engine(engine), numLeds(numLeds) {}
+
+    void begin(BaseType_t core = 0);
+    void follow(uint32_t now, float speed);
+    void start(int fxId);
+    void stop();
+    // Whether the other core may be drawing an effect, so its settings must
+    // wait. Only call it from the task which calls start() and stop().
+    bool warming(int fxId) const { return running && fxId == warmId; }
+
+  private:
+    FxEngine &engine;
+    uint16_t numLeds;
+    fl::scoped_array<CRGB> scratch; // the pre-warmed frames are discarded
+    TaskHandle_t taskHandle = nullptr;
+    SemaphoreHandle_t idle = nullptr; // given when the task stops drawing
+    FxPtr fx;                         // the effect being pre-warmed
+    int warmId = -1;                  // and its id
+    std::atomic<bool> running{false}; // the task is drawing fx
+    uint32_t realMs = 0;              // millis() when follow() last ran
+    uint32_t fxMs = 0;                // FxEngine's clock then
+    std::atomic<uint32_t> clockMs{0}; // which the task draws at
+    uint32_t startMs = 0;             // when pre-warming started
+    int32_t heapUsed = 0;             // heap taken while drawing frame one
+    uint32_t µsBusy = 0;              // time spent drawing on the other core
+    uint32_t frames = 0;              // frames drawn on the other core
+    const uint32_t stackSize = 8192;
+    Telemetry::Handle cpuHandle, framesHandle, memHandle;
+
+    static void task(void *param);
+};
+
+// Create the pre-warm task on the core not running loop()
+void Prewarmer::begin(BaseType_t core) {
+    scratch.reset(new CRGB[numLeds]);
+    idle = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(task, "prewarm", stackSize, this, 1, &taskHandle,
+                            core);
+    cpuHandle = telemetry.add("prewarm CPU", {.unit = "%", .teleplot = ""});
+    framesHandle = telemetry.add("prewarm frames", String(0));
+    memHandle = telemetry.add("prewarm mem", {.unit = "KiB", .teleplot = ""});
+}
+
+// Advance the copy of FxEngine's clock. Call it with the same time and speed
+// as FxEngine, once a frame.
+void Prewarmer::follow(uint32_t now, float speed) {
+    fxMs += int32_t((now - realMs) * speed);
+    realMs = now;
+    clockMs.store(fxMs, std::memory_order_relaxed);
+}
+
+// Begin advancing the effect which FxEngine will switch to next, by its id
+void Prewarmer::start(int fxId) {
+    if (running || !taskHandle || fxId == engine.getCurrentFxId())
+        return;
+    fx = engine.getFx(fxId);
+    if (!fx)
+        return;
+    warmId = fxId;
+
+    startMs = millis();
+    heapUsed = 0;
+    µsBusy = frames = 0;
+    running = true;
+    xTaskNotifyGive(taskHandle);
+}
+
+// Wait for the other core to finish its frame, then report what it cost
+void Prewarmer::stop() {
+    if (!running)
+        return;
+    running = false;
+    xSemaphoreTake(idle, portMAX_DELAY);
+    fx.reset();
+
+    // Memory is the scratch frame and the stack used, exactly, plus however
+    // much the heap shrank while the first frame built the effect's state.
+    // Other tasks allocate and free meanwhile, so that part is approximate.
+    uint32_t elapsed = millis() - startMs;
+    if (elapsed)
+        telemetry.set(cpuHandle, µsBusy / (10.f * elapsed));
+    telemetry.set(framesHandle, frames);
+    int32_t bytes = numLeds * sizeof(CRGB) + stackSize -
+                    uxTaskGetStackHighWaterMark(taskHandle) + heapUsed;
+    telemetry.set(memHandle, bytes / 1024.f);
+}
+
+void Prewarmer::task(void *param) {
+    Prewarmer *self = (Prewarmer *)param;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (self->running) {
+            const uint32_t now =
+                self->clockMs.load(std::memory_order_relaxed);
+            const uint32_t heapFree = self->frames ? 0 : ESP.getFreeHeap();
+            uint32_t µs = micros();
+            self->fx->draw(Fx::DrawContext(now, self->scratch.get()));
+            self->µsBusy += micros() - µs;
+            if (!self->frames++)
+                self->heapUsed = heapFree - ESP.getFreeHeap();
+            vTaskDelay(1); // leave time for WiFi and friends
+        }
+        xSemaphoreGive(self->idle);
+    }
+}
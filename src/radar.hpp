@@ -1,55 +1,104 @@
 #pragma once
 #include "LD2450.h"
+#include "snapshot.hpp"
+#include "tracker.hpp"
 
+#define RADAR_MAX_TARGETS 3
 
-void radar(CRGB *leds, XYMap &xyMap, LD2450 &ld2450)
+// The targets from one LD2450 report
+struct RadarSnapshot
 {
-  const int gotTargets = ld2450.read();
-  if (gotTargets <= 0)
-    return;
-
-  uint8_t printCnt = 0;
-  static uint16_t pos[3]{0, 0, 0};
-  static uint32_t lastMillis[3]{0, 0, 0};
-  for (int i = 0; i < ld2450.getSensorSupportedTargetCount(); i++)
+  uint32_t ms = 0;       // when the report was parsed
+  uint32_t sequence = 0; // increments with each report
+  uint8_t count = 0;     // number of targets the sensor supports
+  LD2450::RadarTarget targets[RADAR_MAX_TARGETS];
+};
+
+// Parsed by radarTask(), read by radar() without blocking
+TripleBuffer<RadarSnapshot> radarTargets;
+TaskHandle_t radarTaskHandle = nullptr;
+uint32_t radarPollMs = 100; // wake this often if no UART event arrives
+void (*radarPublish)(const RadarSnapshot &) = nullptr; // e.g. send it on
+
+// Copy the targets from the report most recently parsed by ld2450
+void radarSnapshot(LD2450 &ld2450, RadarSnapshot &snapshot)
+{
+  snapshot.count = ld2450.getSensorSupportedTargetCount();
+  if (snapshot.count > RADAR_MAX_TARGETS)
+    snapshot.count = RADAR_MAX_TARGETS;
+  for (int i = 0; i < snapshot.count; i++)
+    snapshot.targets[i] = ld2450.getTarget(i);
+}
+
+// Parse LD2450 reports as UART data arrives, and publish the targets
+void radarTask(void *param)
+{
+  LD2450 &ld2450 = *(LD2450 *)param;
+  uint32_t sequence = 0;
+  for (;;)
   {
-    const LD2450::RadarTarget target = ld2450.getTarget(i);
-    // if (0 == i)
-    //   target.valid = true, target.speed = sinf(millis() / 1000.f) * 100;
+    // Woken by the UART, or periodically in case a notification was missed
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(radarPollMs));
+    if (ld2450.read() <= 0)
+      continue;
+    RadarSnapshot &snapshot = radarTargets.back();
+    snapshot.ms = millis();
+    snapshot.sequence = ++sequence;
+    radarSnapshot(ld2450, snapshot);
+    if (radarPublish)
+      radarPublish(snapshot);
+    radarTargets.publish();
+  }
+}
 
-    if (target.valid && abs(target.speed) > 0)
-    {
-      printCnt++;
-      // Serial.printf("id:%u xy:%5d,%5d res:%4u spd:%4d dst:%5u (%d %d, %d %d)  ",
-      //               target.id, target.x, target.y, target.resolution, target.speed, target.distance,
-      //               target.xmin, target.xmax, target.ymin, target.ymax);
-      if (lastMillis[i] - millis() >= 50)
-      {
-        if (target.speed > 0)
-          pos[i] += target.speed;
-        else
-          pos[i] -= -target.speed;
-        lastMillis[i] = millis();
-      }
-    }
-    // Reset if target is not moving
-    if (lastMillis[i] && (millis() - lastMillis[i] > 5000))
-    {
-      lastMillis[i] = 0;
-    }
-    if (lastMillis[i])
+// Move LD2450 parsing off the render loop into its own task
+void radarBegin(LD2450 &ld2450, HardwareSerial &serial)
+{
+  xTaskCreatePinnedToCore(radarTask, "radar", 4096, &ld2450, 2, &radarTaskHandle, 0);
+  serial.onReceive([]()
+                   { xTaskNotifyGive(radarTaskHandle); });
+}
+
+// Follows each target between reports, so radar state can be sampled smoothly
+// by effects on every frame
+RadarTracker radarTracker;
+
+// Feed the valid targets from a report to a tracker
+void radarTrack(RadarTracker &tracker, const RadarSnapshot &snapshot)
+{
+  Detection detections[RADAR_MAX_TARGETS];
+  uint8_t count = 0;
+  for (int i = 0; i < snapshot.count; i++)
+    if (snapshot.targets[i].valid)
+      detections[count++] = {float(snapshot.targets[i].x), float(snapshot.targets[i].y)};
+  tracker.update(snapshot.ms, detections, count);
+}
+
+// Draw the radar overlay for the tracked targets at time now
+void radarDraw(CRGB *leds, XYMap &xyMap, const RadarTracker &tracker, uint32_t now)
+{
+  for (int i = 0; i < TRACKER_MAX_TRACKS; i++)
+  {
+    // Show targets which have moved in the last 5 seconds
+    const Track &track = tracker.tracks[i];
+    if (!track.active || !track.movingMs || now - track.movingMs > 5000)
+      continue;
+
+    // plot a scroller which moves as the target approaches or recedes
+    float tx, ty;
+    tracker.predict(i, now, tx, ty);
+    uint16_t ipos = hypotf(tx, ty) * 16;
+    for (int x = 0; x < MATRIX_WIDTH; x++)
     {
-      // plot a scroller indicating the speed
-      uint16_t ipos = pos[i];
-      for (int x = 0; x < MATRIX_WIDTH; x++)
-      {
-        leds[xyMap.mapToIndex(x, i)] = CHSV(millis() / 32 + i * 86, 255, ((ipos >> 10) % 8) * 32);
-        ipos += 256 * 4; // * (target.speed >= 0 ? 1 : -1);
-      }
+      leds[xyMap.mapToIndex(x, i)] = CHSV(now / 32 + i * 86, 255, ((ipos >> 10) % 8) * 32);
+      ipos += 256 * 4;
     }
   }
-  if (printCnt > 0)
-  {
-    // Serial.println();
-  }
+}
+
+void radar(CRGB *leds, XYMap &xyMap)
+{
+  if (radarTargets.update())
+    radarTrack(radarTracker, radarTargets.front());
+  radarDraw(leds, xyMap, radarTracker, millis());
 }
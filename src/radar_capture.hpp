@@ -0,0 +1,238 @@
+#pragma once
+#include "preferences.hpp"
+#include "radar.hpp"
+#include "radar_record.hpp"
+#include <LittleFS.h>
+#include <lwip/sockets.h>
+
+// Record the raw LD2450 byte stream with timestamps, and play it back through
+// the same parser and radar() path, so the radar can be tested and benchmarked
+// without the sensor attached.
+
+const char *radarCapturePath = "/radar.cap";
+
+// Flush a capture to flash this often, so a crash or reboot loses at most
+// this much of it. Flushing every record rewrote LittleFS's metadata for each
+// few bytes.
+#if !defined(RADAR_CAPTURE_FLUSH_MS)
+#define RADAR_CAPTURE_FLUSH_MS 1000
+#endif
+
+// Passes bytes through from the UART to the parser, recording them to a file
+// in flash or sending them over UDP
+class RadarTap : public Stream {
+  public:
+    RadarTap(Stream &source) : source(source) {}
+
+    bool beginFile(const char *path, size_t maxBytes = 1 << 20);
+    bool beginUDP(const char *host, uint16_t port);
+
+    int available() override { return source.available(); }
+    int peek() override { return source.peek(); }
+    int read() override {
+        int c = source.read();
+        if (c >= 0 && (file || udpSocket >= 0))
+            record(c);
+        return c;
+    }
+    size_t write(uint8_t c) override { return source.write(c); }
+    void flush() override { source.flush(); }
+
+  private:
+    Stream &source;
+    File file;
+    size_t maxBytes = 0;            // stop recording to flash at this size
+    size_t fileBytes = 0;           // bytes written to the file
+    uint32_t flushMs = 0;           // when the file was last flushed
+    int udpSocket = -1;             // socket for recording over UDP
+    struct sockaddr_in udpSockAddr; // where to send the records
+    RadarCaptureHeader header{0, 0};
+    uint8_t buffer[256];
+
+    void record(uint8_t c);
+    void flushRecord();
+};
+
+bool RadarTap::beginFile(const char *path, size_t bytes) {
+    file = LittleFS.open(path, FILE_WRITE);
+    maxBytes = bytes;
+    fileBytes = 0;
+    flushMs = millis();
+    return file;
+}
+
+bool RadarTap::beginUDP(const char *host, uint16_t port) {
+    memset(&udpSockAddr, 0, sizeof(udpSockAddr));
+    udpSockAddr.sin_family = AF_INET;
+    udpSockAddr.sin_port = htons(port);
+    if (1 != inet_aton(host, &udpSockAddr.sin_addr))
+        return false;
+    udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    return udpSocket >= 0;
+}
+
+// Bytes read in the same millisecond share a record
+void RadarTap::record(uint8_t c) {
+    uint32_t ms = millis();
+    if (header.len && (ms != header.ms || header.len == sizeof(buffer)))
+        flushRecord();
+    header.ms = ms;
+    buffer[header.len++] = c;
+}
+
+void RadarTap::flushRecord() {
+    if (file) {
+        file.write((const uint8_t *)&header, sizeof(header));
+        file.write(buffer, header.len);
+        fileBytes += sizeof(header) + header.len;
+        if (fileBytes >= maxBytes)
+            file.close();
+        else if (header.ms - flushMs >= RADAR_CAPTURE_FLUSH_MS)
+            file.flush(), flushMs = header.ms;
+    }
+    if (udpSocket >= 0) {
+        uint8_t packet[sizeof(header) + sizeof(buffer)];
+        memcpy(packet, &header, sizeof(header));
+        memcpy(packet + sizeof(header), buffer, header.len);
+        sendto(udpSocket, packet, sizeof(header) + header.len, 0,
+               (struct sockaddr *)&udpSockAddr, sizeof(udpSockAddr));
+    }
+    header.len = 0;
+}
+
+// Feeds a capture to the parser, either at the recorded pace or as fast as it
+// can be read
+class RadarReplay : public Stream {
+  public:
+    bool begin(const char *path, bool realtime = true, bool loop = true);
+
+    int available() override;
+    int peek() override { return available() ? file.peek() : -1; }
+    int read() override {
+        if (!available())
+            return -1;
+        remaining--;
+        return file.read();
+    }
+    size_t write(uint8_t c) override { return 1; } // the sensor isn't there
+
+    uint32_t recordMs() const { return header.ms; } // when the bytes were read
+    size_t size() { return file.size(); }
+
+  private:
+    File file;
+    bool realtime = true;       // pace the bytes as they were recorded
+    bool loop = true;           // restart at the end of the file
+    uint32_t startMs = 0;       // millis() when replay started
+    uint32_t firstMs = 0;       // timestamp of the first record
+    uint16_t remaining = 0;     // bytes left in the current record
+    RadarCaptureHeader header{0, 0};
+
+    bool nextRecord();
+};
+
+bool RadarReplay::begin(const char *path, bool paced, bool repeat) {
+    file = LittleFS.open(path, FILE_READ);
+    realtime = paced, loop = repeat;
+    if (!file || !nextRecord())
+        return false;
+    firstMs = header.ms;
+    startMs = millis();
+    return true;
+}
+
+bool RadarReplay::nextRecord() {
+    if (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header)) {
+        remaining = header.len;
+        return true;
+    }
+    if (!loop)
+        return false;
+    file.seek(0);
+    if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header))
+        return false;
+    remaining = header.len;
+    firstMs = header.ms;
+    startMs = millis();
+    return true;
+}
+
+// Bytes are only available once their recorded time has come
+int RadarReplay::available() {
+    while (!remaining)
+        if (!nextRecord())
+            return 0;
+    if (realtime && header.ms - firstMs > millis() - startMs)
+        return 0;
+    return remaining;
+}
+
+RadarTap *radarTap = nullptr;
+RadarReplay radarReplay;
+
+// Choose where the LD2450 parser reads from, according to preferences:
+// "radar_replay" plays /radar.cap instead of using the sensor, and
+// "radar_capture" records the sensor to flash (1) or over UDP (2).
+Stream &radarSource(HardwareSerial &serial) {
+    const bool replay = preferences.getBool("radar_replay", false);
+    const uint8_t capture = preferences.getUChar("radar_capture", 0);
+    if (!replay && !capture)
+        return serial;
+    if (!LittleFS.begin(true))
+        return serial;
+
+    if (replay && radarReplay.begin(radarCapturePath)) {
+        radarPollMs = 10; // there are no UART events to wake the radar task
+        return radarReplay;
+    }
+
+    radarTap = new RadarTap(serial);
+    if (1 == capture)
+        radarTap->beginFile(radarCapturePath);
+    else if (2 == capture)
+        radarTap->beginUDP(
+            preferences.getString("telemetry_host", "").c_str(),
+            preferences.getUInt("radar_capture_port", 47270));
+    return *radarTap;
+}
+
+// Measure LD2450 parser throughput and the cost of the radar overlay, using
+// the capture in flash
+void benchmarkRadar(CRGB *leds) {
+    RadarReplay replay;
+    if (!LittleFS.begin() || !replay.begin(radarCapturePath, false, false)) {
+        Serial.printf("No radar capture at %s\r\n", radarCapturePath);
+        return;
+    }
+    LD2450 parser;
+    parser.begin(replay);
+    RadarTracker tracker;
+    RadarSnapshot snapshot;
+    const size_t bytes = replay.size();
+    uint32_t frames = 0, µsParse = 0, µsDraw = 0, draws = 0;
+
+    while (replay.available()) {
+        uint32_t us = micros();
+        int got = parser.read();
+        µsParse += micros() - us;
+        if (got <= 0)
+            continue;
+        frames++;
+
+        // Track the report, then draw as many frames as we would before the
+        // next report arrives
+        us = micros();
+        snapshot.ms = replay.recordMs();
+        radarSnapshot(parser, snapshot);
+        radarTrack(tracker, snapshot);
+        for (uint32_t ms = 0; ms < 100; ms += 10, draws++)
+            radarDraw(leds, xyMap, tracker, snapshot.ms + ms);
+        µsDraw += micros() - us;
+    }
+
+    Serial.printf("Radar parse\t%u bytes\t%u frames\t%.0f frames/s\r\n",
+                  unsigned(bytes), unsigned(frames),
+                  µsParse ? frames * 1e6f / µsParse : 0.f);
+    Serial.printf("Radar overlay\t%.1fus/frame\r\n",
+                  draws ? float(µsDraw) / draws : 0.f);
+}
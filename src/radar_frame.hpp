@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The UDP frame a remote radar node sends for each LD2450 report. Fields are
+// little-endian, as both the ESP32 and any PC we'd test on are. Only `count`
+// targets are sent, so a frame is 12 to 42 bytes. Bump the version whenever
+// the layout changes; receivers drop frames with a version they don't know.
+// Nothing here depends on Arduino, so it can be built for a PC too.
+
+#define RADAR_FRAME_MAGIC 0x524c // "LR"
+#define RADAR_FRAME_VERSION 1
+#define RADAR_FRAME_MAX_TARGETS 3
+#define RADAR_FRAME_PORT 47271
+
+struct __attribute__((packed)) RadarFrameTarget {
+    uint8_t id;
+    uint8_t valid;
+    int16_t x, y;        // mm
+    int16_t speed;       // cm/s, as reported by the sensor
+    uint16_t resolution; // mm
+};
+
+struct __attribute__((packed)) RadarFrame {
+    uint16_t magic = RADAR_FRAME_MAGIC;
+    uint8_t version = RADAR_FRAME_VERSION;
+    uint8_t count = 0;     // number of targets which follow
+    uint32_t sequence = 0; // increments with each report
+    uint32_t sensorMs = 0; // sender's millis() when the report was parsed
+    RadarFrameTarget targets[RADAR_FRAME_MAX_TARGETS];
+};
+
+// Bytes on the wire for a frame with count targets
+inline size_t radarFrameBytes(uint8_t count) {
+    return offsetof(RadarFrame, targets) + count * sizeof(RadarFrameTarget);
+}
+
+// Copy a received datagram into frame. Returns false if it isn't a frame we
+// understand.
+inline bool radarFrameDecode(const void *data, size_t len, RadarFrame &frame) {
+    if (len < radarFrameBytes(0) || len > sizeof(frame))
+        return false;
+    memcpy(&frame, data, len);
+    return frame.magic == RADAR_FRAME_MAGIC &&
+           frame.version == RADAR_FRAME_VERSION &&
+           frame.count <= RADAR_FRAME_MAX_TARGETS &&
+           len == radarFrameBytes(frame.count);
+}
+
+// Classify received sequence numbers. Only frames newer than any before are
+// accepted. A gap counts as lost frames, until they turn up late. Only the
+// frames skipped over in the last 32 can turn up; anything older, or from
+// before the first frame or a restart, is just late.
+struct RadarSequence {
+    uint32_t last = 0;      // newest sequence accepted
+    uint32_t seen = 0;      // bit n is set if last - n has been received
+    uint32_t missing = 0;   // bit n is set if last - n was counted as lost
+    uint32_t received = 0;  // frames accepted
+    uint32_t lost = 0;      // frames skipped over and not yet seen
+    uint32_t late = 0;      // frames which arrived after a newer one
+    uint32_t duplicate = 0; // frames seen more than once
+    uint32_t restarts = 0;  // times the sender appeared to restart
+
+    bool accept(uint32_t sequence) {
+        const int32_t gap = int32_t(sequence - last);
+        if (received && gap <= 0 && gap > -1000) {
+            const uint32_t age = -gap;
+            const uint32_t bit = age < 32 ? 1u << age : 0;
+            if (seen & bit) {
+                duplicate++;
+                return false;
+            }
+            if (missing & bit)
+                missing &= ~bit, lost--;
+            seen |= bit;
+            late++;
+            return false;
+        }
+
+        // A sequence far from the last means the sender rebooted
+        if (received && gap > 0 && gap < 1000) {
+            lost += gap - 1;
+            seen = gap < 32 ? seen << gap | 1 : 1;
+            missing = gap < 32 ? missing << gap | ((1u << gap) - 2) : ~1u;
+        } else {
+            restarts += received > 0;
+            seen = 1, missing = 0;
+        }
+        last = sequence;
+        received++;
+        return true;
+    }
+};
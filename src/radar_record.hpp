@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+// A radar capture is a sequence of records: a RadarCaptureHeader followed by
+// `len` bytes which were read from the LD2450's UART during millisecond `ms`.
+// Records sent over UDP are one per datagram, in the same format, so the
+// datagrams saved one after another make a capture file. Nothing here depends
+// on Arduino, so captures can be replayed on a PC too.
+
+struct __attribute__((packed)) RadarCaptureHeader {
+    uint32_t ms;  // millis() when the bytes were read
+    uint16_t len; // number of bytes which follow
+};
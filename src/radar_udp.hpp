@@ -0,0 +1,182 @@
+#pragma once
+#include "preferences.hpp"
+#include "radar.hpp"
+#include "radar_frame.hpp"
+#include <lwip/sockets.h>
+
+// Put the LD2450 somewhere useful: a sender node parses its own sensor and
+// sends each report as a RadarFrame over UDP, and the LED controller receives
+// them into radarTargets, exactly where radarTask() would have put them.
+//
+// Preferences: "radar_role" 0 uses the local sensor, 1 also sends its reports
+// to "radar_peer", 2 receives reports instead of using the local sensor.
+
+enum RadarRole : uint8_t { radarLocal, radarSender, radarReceiver };
+
+class RadarLink {
+  public:
+    uint8_t role = radarLocal;
+
+    void begin();
+    void report();
+
+  private:
+    int udpSocket = -1;
+    struct sockaddr_in peer;
+    TaskHandle_t taskHandle = nullptr;
+
+    // Written by the sender or receiver task, read by report() in loop().
+    // Aligned 32-bit loads and stores don't tear on the ESP32.
+    RadarSequence sequence;
+    uint32_t sent = 0;       // frames sent
+    uint32_t minOffset = 0;  // least receive time - sensor time this window
+    uint32_t windowMs = 0;   // when the minOffset window started
+    uint32_t delaySum = 0;   // sum of delays above minOffset
+    uint32_t delayCount = 0; // number of delays in delaySum
+
+    // Last values reported
+    uint32_t reportMs = 0;
+    uint32_t reportSent = 0;
+    uint32_t reportReceived = 0;
+    uint32_t reportDelaySum = 0;
+    uint32_t reportDelayCount = 0;
+    struct {
+        Telemetry::Handle rate = Telemetry::none, lost = Telemetry::none;
+        Telemetry::Handle late = Telemetry::none, delay = Telemetry::none;
+    } handles;
+
+    static void send(const RadarSnapshot &snapshot);
+    static void receiveTask(void *param);
+    void receive(const RadarFrame &frame);
+};
+
+RadarLink radarLink;
+
+void RadarLink::begin() {
+    role = preferences.getUChar("radar_role", radarLocal);
+    if (radarLocal == role)
+        return;
+    udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udpSocket < 0) {
+        LOG_ERROR("Failed to create UDP socket for radar");
+        role = radarLocal;
+        return;
+    }
+
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(preferences.getUInt("radar_port", RADAR_FRAME_PORT));
+    if (radarSender == role) {
+        String host = preferences.getString("radar_peer", "");
+        if (1 != inet_aton(host.c_str(), &peer.sin_addr))
+            LOG_ERROR("Bad radar_peer address '%s'", host);
+        handles.rate =
+            telemetry.add("radar tx", {.unit = "Hz", .teleplot = ""});
+        radarPublish = send;
+        return;
+    }
+
+    peer.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(udpSocket, (struct sockaddr *)&peer, sizeof(peer)) < 0) {
+        LOG_ERROR("Failed to bind UDP socket for radar");
+        return;
+    }
+    handles.rate = telemetry.add("radar rx", {.unit = "Hz", .teleplot = ""});
+    handles.lost = telemetry.add("radar lost", {.maxMs = 600000});
+    handles.late = telemetry.add("radar late", {.maxMs = 600000});
+    handles.delay =
+        telemetry.add("radar delay", {.unit = "ms", .teleplot = ""});
+    xTaskCreatePinnedToCore(receiveTask, "radar rx", 4096, this, 2,
+                            &taskHandle, 0);
+}
+
+// Called by radarTask() with each report parsed from the local sensor
+void RadarLink::send(const RadarSnapshot &snapshot) {
+    RadarLink &link = radarLink;
+    RadarFrame frame;
+    frame.sequence = snapshot.sequence;
+    frame.sensorMs = snapshot.ms;
+    frame.count = snapshot.count;
+    for (int i = 0; i < frame.count; i++) {
+        const LD2450::RadarTarget &target = snapshot.targets[i];
+        frame.targets[i] = {uint8_t(target.id), target.valid,
+                            target.x,           target.y,
+                            target.speed,       target.resolution};
+    }
+    if (sendto(link.udpSocket, &frame, radarFrameBytes(frame.count), 0,
+               (struct sockaddr *)&link.peer, sizeof(link.peer)) > 0)
+        link.sent++;
+}
+
+void RadarLink::receiveTask(void *param) {
+    RadarLink &link = *(RadarLink *)param;
+    uint8_t buffer[sizeof(RadarFrame) + 1]; // + 1 to spot oversized datagrams
+    RadarFrame frame;
+    for (;;) {
+        int len = recv(link.udpSocket, buffer, sizeof(buffer), 0);
+        if (len > 0 && radarFrameDecode(buffer, len, frame))
+            link.receive(frame);
+    }
+}
+
+// Publish a frame's targets as if the local sensor had reported them, unless
+// a newer frame has already been published
+void RadarLink::receive(const RadarFrame &frame) {
+    const uint32_t now = millis();
+    if (!sequence.accept(frame.sequence))
+        return;
+
+    // The clocks aren't synchronised, so measure the delay relative to the
+    // quickest frame in the last 10 seconds, which allows for clock drift
+    const uint32_t offset = now - frame.sensorMs;
+    if (1 == sequence.received || now - windowMs > 10000 ||
+        int32_t(offset - minOffset) < 0)
+        minOffset = offset, windowMs = now;
+    delaySum += offset - minOffset;
+    delayCount++;
+
+    RadarSnapshot &snapshot = radarTargets.back();
+    snapshot.ms = now;
+    snapshot.sequence = frame.sequence;
+    snapshot.count = frame.count;
+    for (int i = 0; i < frame.count; i++) {
+        const RadarFrameTarget &in = frame.targets[i];
+        LD2450::RadarTarget &target = snapshot.targets[i];
+        target = LD2450::RadarTarget{};
+        target.id = in.id;
+        target.valid = in.valid;
+        target.x = in.x;
+        target.y = in.y;
+        target.speed = in.speed;
+        target.resolution = in.resolution;
+        target.distance = hypotf(in.x, in.y);
+    }
+    radarTargets.publish();
+}
+
+// Send link statistics to Telemetry, from loop()
+void RadarLink::report() {
+    if (radarLocal == role)
+        return;
+    const uint32_t now = millis();
+    const uint32_t elapsed = now - reportMs;
+    if (elapsed < 1000)
+        return;
+    reportMs = now;
+
+    if (radarSender == role) {
+        telemetry.set(handles.rate, (sent - reportSent) * 1000.f / elapsed);
+        reportSent = sent;
+        return;
+    }
+    const uint32_t received = sequence.received;
+    telemetry.set(handles.rate, (received - reportReceived) * 1000.f / elapsed);
+    reportReceived = received;
+    telemetry.set(handles.lost, sequence.lost);
+    telemetry.set(handles.late, sequence.late + sequence.duplicate);
+    const uint32_t sum = delaySum, count = delayCount;
+    if (count != reportDelayCount)
+        telemetry.set(handles.delay,
+                      float(sum - reportDelaySum) / (count - reportDelayCount));
+    reportDelaySum = sum, reportDelayCount = count;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <Arduino.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <string.h>
+
+// Resolve hostnames without ever blocking the caller. resolve() answers from
+// a small cache, and if the answer is missing or old, asks a low-priority
+// task to look the name up and returns what it has. Failures are cached
+// too, for a shorter time, so a dead DNS server isn't asked on every call.
+// refresh() re-resolves every cached name in the background, for when WiFi
+// reconnects, perhaps to a different network.
+
+#define RESOLVER_ENTRIES 4
+#define RESOLVER_HOST_MAX 64
+
+class Resolver {
+  public:
+    // Look a name up, blocking. Replaceable, to test against a stub.
+    typedef bool (*Lookup)(const char *host, in_addr &address);
+    Lookup lookup = getAddress;
+    uint32_t ttlMs = 300000;        // how long an address is trusted
+    uint32_t negativeTtlMs = 30000; // how long to wait to retry a failure
+
+    void begin();
+    bool resolve(const char *host, in_addr &address);
+    void refresh();
+
+    static bool getAddress(const char *host, in_addr &address);
+
+  private:
+    struct Entry {
+        char host[RESOLVER_HOST_MAX] = ""; // empty if the entry is unused
+        in_addr address = {};
+        bool valid = false;      // address was resolved, perhaps long ago
+        bool failed = false;     // the last lookup failed
+        bool due = false;        // waiting for the task to look it up
+        uint32_t resolvedMs = 0; // when the last lookup finished
+        uint32_t usedMs = 0;     // when resolve() last asked for it
+    };
+    Entry entries[RESOLVER_ENTRIES];
+    SemaphoreHandle_t mutex = nullptr;
+    TaskHandle_t taskHandle = nullptr;
+
+    static void task(void *param);
+    void lookupDue();
+};
+
+Resolver resolver;
+
+void Resolver::begin() {
+    if (mutex)
+        return;
+    mutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(task, "resolver", 4096, this, 0, &taskHandle, 0);
+}
+
+// Copy the address of host to address, and return true, if it has ever been
+// resolved. Otherwise, or if the address has expired, queue a lookup.
+bool Resolver::resolve(const char *host, in_addr &address) {
+    if (!mutex || strlen(host) >= RESOLVER_HOST_MAX)
+        return false;
+    const uint32_t now = millis();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Entry *entry = nullptr, *oldest = &entries[0];
+    for (Entry &e : entries) {
+        if (!strcmp(e.host, host))
+            entry = &e;
+        if (int32_t(e.usedMs - oldest->usedMs) < 0)
+            oldest = &e;
+    }
+    if (!entry) {
+        entry = oldest; // forget the name least recently asked for
+        *entry = Entry{};
+        strcpy(entry->host, host);
+        entry->due = true;
+    }
+    entry->usedMs = now;
+    const uint32_t age = now - entry->resolvedMs;
+    if (age >= (entry->failed ? negativeTtlMs : ttlMs))
+        entry->due = true;
+    const bool valid = entry->valid, due = entry->due;
+    if (valid)
+        address = entry->address;
+    xSemaphoreGive(mutex);
+    if (due)
+        xTaskNotifyGive(taskHandle);
+    return valid;
+}
+
+// Look up every cached name again, keeping the old addresses meanwhile
+void Resolver::refresh() {
+    if (!mutex)
+        return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (Entry &e : entries)
+        e.due = e.host[0];
+    xSemaphoreGive(mutex);
+    xTaskNotifyGive(taskHandle);
+}
+
+void Resolver::task(void *param) {
+    Resolver &self = *(Resolver *)param;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self.lookupDue();
+    }
+}
+
+// Look up each due name, without holding the lock while blocked on DNS
+void Resolver::lookupDue() {
+    for (Entry &e : entries) {
+        char host[RESOLVER_HOST_MAX];
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        const bool due = e.due;
+        strcpy(host, e.host);
+        xSemaphoreGive(mutex);
+        if (!due)
+            continue;
+
+        in_addr address;
+        const bool ok = lookup(host, address);
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (!strcmp(e.host, host)) { // unless it was replaced meanwhile
+            if (ok)
+                e.address = address, e.valid = true;
+            e.failed = !ok;
+            e.due = false;
+            e.resolvedMs = millis();
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+bool Resolver::getAddress(const char *host, in_addr &address) {
+    struct addrinfo hints = {}, *result = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, nullptr, &hints, &result) || !result)
+        return false;
+    address = ((struct sockaddr_in *)result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+    return true;
+}
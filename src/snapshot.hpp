@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+// Pass the latest value of T from one producer to one consumer without locks
+// or blocking. The producer fills back() then calls publish(). The consumer
+// calls update() then reads front(). Each side owns one buffer; the third sits
+// in the middle and is swapped atomically, so neither side ever waits and the
+// consumer always sees a complete value. Intermediate values may be skipped.
+template <typename T> class TripleBuffer {
+  public:
+    // Producer: the buffer to fill next
+    T &back() { return buffers[backIndex]; }
+
+    // Producer: make back() visible to the consumer
+    void publish() {
+        uint8_t old = middle.exchange(backIndex | freshBit,
+                                      std::memory_order_acq_rel);
+        backIndex = old & indexMask;
+    }
+
+    // Consumer: swap in the newest published value. Returns false if nothing
+    // has been published since the last call, leaving front() unchanged.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+        uint8_t old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & indexMask;
+        return true;
+    }
+
+    // Consumer: the newest value received by update()
+    const T &front() const { return buffers[frontIndex]; }
+
+  private:
+    static const uint8_t indexMask = 3;
+    static const uint8_t freshBit = 4;
+    T buffers[3] = {};
+    std::atomic<uint8_t> middle{1};
+    uint8_t backIndex = 0;  // only touched by the producer
+    uint8_t frontIndex = 2; // only touched by the consumer
+};
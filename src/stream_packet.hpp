@@ -0,0 +1,272 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pixel data from a show controller, in any of the three protocols they all
+// speak: DDP, E1.31 (sACN) and Art-Net. Each parser checks a datagram and
+// points a StreamPacket into it, so nothing is copied until StreamAssembler
+// writes the pixels into a frame. Fields on the wire are big-endian, except
+// Art-Net's opcode and version. Nothing here depends on Arduino, so it can be
+// built for a PC too.
+
+#define DDP_PORT 4048
+#define E131_PORT 5568
+#define ARTNET_PORT 6454
+#define STREAM_MAX_UNIVERSES 32 // E1.31 and Art-Net universes per frame
+
+enum StreamProtocol : uint8_t { streamDDP, streamE131, streamArtNet };
+
+struct StreamPacket {
+    uint8_t protocol = streamDDP;
+    bool sync = false;       // a sync packet, with no data
+    bool push = false;       // DDP: the frame is complete
+    bool terminated = false; // E1.31: the source has stopped sending
+    uint8_t sequence = 0;    // 0 if the sender doesn't number packets
+    uint16_t universe = 0;   // of the data, or a sync packet's sync address
+    uint16_t syncUniverse = 0;  // E1.31: hold the data for this sync, or 0
+    uint32_t offset = 0;        // DDP: the first byte of the frame to write
+    const uint8_t *data = NULL; // points into the datagram
+    uint16_t length = 0;        // bytes of data
+};
+
+inline uint16_t streamGet16(const uint8_t *p) { return p[0] << 8 | p[1]; }
+inline uint32_t streamGet32(const uint8_t *p) {
+    return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// DDP: flags (version 1, timecode, push), sequence (low 4 bits), data type,
+// destination, offset (32 bits), length (16 bits), an optional timecode, then
+// the data. Only RGB data for the default output is accepted.
+inline bool ddpParse(const uint8_t *in, size_t len, StreamPacket &packet) {
+    if (len < 10 || 0x40 != (in[0] & 0xc0) || 1 != in[3])
+        return false;
+    const uint8_t type = in[2]; // 0 or 1 in older senders, 0x0b for RGB 8 bit
+    if (type > 1 && 0x0b != type)
+        return false;
+    const size_t header = in[0] & 0x10 ? 14 : 10;
+    packet = StreamPacket();
+    packet.protocol = streamDDP;
+    packet.push = in[0] & 0x01;
+    packet.sequence = in[1] & 0x0f;
+    packet.offset = streamGet32(in + 4);
+    packet.length = streamGet16(in + 8);
+    packet.data = in + header;
+    return !(in[0] & 0x06) && len >= header + packet.length; // not a query
+}
+
+// E1.31: a root layer, then a framing layer carrying either DMX data for one
+// universe, or a synchronisation packet for a sync address. Preview data is
+// for visualisers, so it is refused like any other unwanted packet.
+inline bool e131Parse(const uint8_t *in, size_t len, StreamPacket &packet) {
+    static const uint8_t identifier[12] = {'A', 'S', 'C', '-', 'E', '1',
+                                           '.', '1', '7', 0,   0,   0};
+    if (len < 49 || 0x0010 != streamGet16(in) || memcmp(in + 4, identifier, 12))
+        return false;
+    packet = StreamPacket();
+    packet.protocol = streamE131;
+    const uint32_t vector = streamGet32(in + 18);
+    if (8 == vector) { // extended, of which only sync is of interest
+        if (1 != streamGet32(in + 40))
+            return false;
+        packet.sync = true;
+        packet.sequence = in[44];
+        packet.universe = streamGet16(in + 45);
+        return true;
+    }
+    if (4 != vector || len < 126 || 2 != streamGet32(in + 40) ||
+        0xa1 != in[118] || in[125]) // not DMX data, with start code 0
+        return false;
+    const uint8_t options = in[112];
+    packet.syncUniverse = streamGet16(in + 109);
+    packet.sequence = in[111];
+    packet.terminated = options & 0x40;
+    packet.universe = streamGet16(in + 113);
+    packet.length = streamGet16(in + 123) - 1;
+    packet.data = in + 126;
+    return !(options & 0x80) && packet.length <= 512 &&
+           len >= 126 + size_t(packet.length);
+}
+
+// Art-Net: ArtDmx carries one universe (a 15-bit port-address), ArtSync
+// says the universes sent since the last one make a frame.
+inline bool artnetParse(const uint8_t *in, size_t len, StreamPacket &packet) {
+    if (len < 14 || memcmp(in, "Art-Net", 8) || in[11] < 14)
+        return false;
+    packet = StreamPacket();
+    packet.protocol = streamArtNet;
+    const uint16_t opcode = in[8] | in[9] << 8;
+    if (0x5200 == opcode) {
+        packet.sync = true;
+        return true;
+    }
+    if (0x5000 != opcode || len < 18)
+        return false;
+    packet.sequence = in[12];
+    packet.universe = (in[15] & 0x7f) << 8 | in[14];
+    packet.length = streamGet16(in + 16);
+    packet.data = in + 18;
+    return packet.length <= 512 && len >= 18 + size_t(packet.length);
+}
+
+// Collects packets into a frame of RGB bytes, and says when it is complete:
+// DDP when a packet is pushed, or reaches the end of the frame if the sender
+// never pushes. E1.31 and Art-Net, when a sync packet arrives if the sender
+// uses them, or else when every universe of the frame has arrived. A frame
+// missing a universe is never completed; the universes received for it are
+// carried into the next.
+//
+// Each E1.31 or Art-Net universe holds `channels` bytes of the frame,
+// starting from firstUniverse. Only the first STREAM_MAX_UNIVERSES of them
+// are followed, so a larger frame is completed without the rest. If remap is
+// set, pixel i of the stream is written to pixel remap[i] of the frame.
+class StreamAssembler {
+  public:
+    uint16_t firstUniverse[3] = {0, 1, 0}; // for each StreamProtocol
+    uint16_t channels = 510; // bytes per universe, 170 pixels, 1 to 512
+
+    // The universes which make up a frame, as many as are followed
+    uint32_t universes() const {
+        const uint32_t n = (size + channels - 1) / channels;
+        return n < STREAM_MAX_UNIVERSES ? n : STREAM_MAX_UNIVERSES;
+    }
+
+    // Counts, for telemetry
+    uint32_t packets = 0;    // data packets written to the frame
+    uint32_t frames = 0;     // frames completed
+    uint32_t lost = 0;       // packets missing from the sequence
+    uint32_t late = 0;       // packets refused as late or repeated
+    uint32_t incomplete = 0; // frames never completed, for a missing universe
+
+    StreamAssembler(uint8_t *frame, size_t size,
+                    const uint16_t *remap = NULL)
+        : frame(frame), size(size), remap(remap) {}
+
+    // Write a packet's pixels into the frame. Returns true if the frame is
+    // now complete. ms is the time now, to let a sender stop sending syncs.
+    bool receive(const StreamPacket &packet, uint32_t ms);
+
+  private:
+    uint8_t *frame;
+    size_t size;
+    const uint16_t *remap;
+    uint64_t received = 0; // bit n is set if universe n has arrived
+    uint8_t sequences[STREAM_MAX_UNIVERSES + 1]; // last of each, DDP's at 0
+    bool numbered[STREAM_MAX_UNIVERSES + 1] = {};
+    uint8_t protocol = streamDDP; // of the last packet
+    bool pushes = false;          // DDP: the sender has pushed a frame
+    uint16_t syncUniverse = 0;    // E1.31: the sync address data is held for
+    uint32_t syncMs = 0;          // when the last sync arrived
+    bool synced = false;          // frames are completed by syncs
+
+    bool inSequence(uint8_t slot, uint8_t sequence, int modulus, int window);
+    void write(uint32_t offset, const uint8_t *data, size_t length);
+};
+
+// Follow a sender's sequence numbers, which count modulo modulus, refusing
+// packets up to window behind the last, which UDP delivered late or twice.
+// DDP counts 1 to 15 and Art-Net 1 to 255, with 0 meaning unnumbered. E1.31
+// counts 0 to 255, and refuses up to 20 behind. xLights and others number
+// DDP frames rather than packets, so a DDP number may repeat.
+inline bool StreamAssembler::inSequence(uint8_t slot, uint8_t sequence,
+                                        int modulus, int window) {
+    if (!sequence && modulus < 256)
+        return true; // the sender doesn't number its packets
+    if (numbered[slot]) {
+        const int gap = (sequence - sequences[slot] + modulus) % modulus;
+        if (!gap && !slot)
+            return true;
+        if (!gap || gap > modulus - window) {
+            late++;
+            return false;
+        }
+        lost += gap - 1;
+    }
+    numbered[slot] = true;
+    sequences[slot] = sequence;
+    return true;
+}
+
+// Copy bytes of the stream into the frame, through the remap if any. Pixels
+// may straddle packets, so bytes before the first whole pixel and after the
+// last are copied one at a time.
+inline void StreamAssembler::write(uint32_t offset, const uint8_t *data,
+                                   size_t length) {
+    if (offset >= size)
+        return;
+    if (length > size - offset)
+        length = size - offset;
+    if (!remap) {
+        memcpy(frame + offset, data, length);
+        return;
+    }
+    size_t i = 0;
+    for (; i < length && (offset + i) % 3; i++)
+        frame[remap[(offset + i) / 3] * 3 + (offset + i) % 3] = data[i];
+    for (; i + 3 <= length; i += 3)
+        memcpy(frame + remap[(offset + i) / 3] * 3, data + i, 3);
+    for (; i < length; i++)
+        frame[remap[(offset + i) / 3] * 3 + (offset + i) % 3] = data[i];
+}
+
+inline bool StreamAssembler::receive(const StreamPacket &packet, uint32_t ms) {
+    if (packet.terminated)
+        return false; // E1.31 says to ignore the data of the last packet
+    // Another sender, so forget the last one's sequence numbers and frame
+    if (packet.protocol != protocol) {
+        memset(numbered, 0, sizeof(numbered));
+        protocol = packet.protocol;
+        received = 0, pushes = synced = false;
+    }
+    if (streamDDP == packet.protocol) {
+        if (!inSequence(0, packet.sequence, 15, 4))
+            return false;
+        write(packet.offset, packet.data, packet.length);
+        packets++;
+        pushes |= packet.push;
+        const bool complete = pushes ? packet.push
+                                     : packet.offset + packet.length >= size;
+        if (!complete)
+            return false;
+        frames++;
+        return true;
+    }
+
+    // A sender which stops sending syncs goes back to completing frames by
+    // their universes after 4 seconds, as Art-Net says
+    if (packet.sync) {
+        if (streamE131 == packet.protocol && packet.universe != syncUniverse)
+            return false;
+        synced = true, syncMs = ms;
+        if (!received)
+            return false; // no data since the last frame
+        received = 0;
+        frames++;
+        return true;
+    }
+    if (ms - syncMs > 4000)
+        synced = false;
+    const uint32_t universe = packet.universe - firstUniverse[packet.protocol];
+    const bool e131 = streamE131 == packet.protocol;
+    if (universe >= universes() ||
+        !inSequence(1 + universe, packet.sequence, e131 ? 256 : 255,
+                    e131 ? 20 : 4))
+        return false;
+    if (packet.syncUniverse)
+        synced = true, syncUniverse = packet.syncUniverse;
+
+    // A universe arriving twice before the frame completed means one went
+    // missing, so start collecting the next frame from here
+    const uint64_t bit = 1ull << universe;
+    if (!synced && (received & bit))
+        incomplete++, received = 0;
+    received |= bit;
+    write(universe * channels, packet.data,
+          packet.length < channels ? packet.length : channels);
+    packets++;
+    if (synced || received != (1ull << universes()) - 1)
+        return false;
+    received = 0;
+    frames++;
+    return true;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include "preferences.hpp"
+#include "snapshot.hpp"
+#include "stream_packet.hpp"
+#include <atomic>
+#include <lwip/sockets.h>
+
+// Receive pixels from a show controller (xLights, FPP, Resolume, etc.) over
+// DDP, E1.31 or Art-Net. A task parses each datagram where it landed and
+// writes its pixels into the frame being assembled, then publishes complete
+// frames through a TripleBuffer, for FxStream to draw without waiting.
+//
+// Preferences: "stream_ddp_port", "stream_e131_port" and "stream_artnet_port"
+// (0 to ignore a protocol), "stream_universe" and "stream_artnet_universe"
+// (the first universe of the matrix), "stream_channels" (bytes per universe,
+// 1 to 512), and "stream_timeout" (ms without a frame before the stream has
+// stopped).
+
+#if !defined(STREAM_TASK_PRIORITY)
+#define STREAM_TASK_PRIORITY 3 // above telemetry, so lwIP's queues don't fill
+#endif
+
+template <uint16_t N> class StreamReceiver {
+  public:
+    static const size_t frameSize = N * 3;
+
+    // A complete frame, and when its last packet arrived
+    struct Frame {
+        uint8_t pixels[frameSize];
+        uint32_t µs;
+    };
+
+    // remap, if set, gives the pixel of the frame for each pixel of the
+    // stream, and must live as long as the receiver
+    bool begin(const uint16_t *remap = nullptr);
+    // Whether a frame has arrived recently, and the stream hasn't ended
+    bool active() const {
+        return frames && millis() - frameMs < timeoutMs && !terminated;
+    }
+    // Consumer: swap in the newest frame. Returns false if there isn't one.
+    bool update() { return frame.update(); }
+    const Frame &front() const { return frame.front(); }
+    // Frames published, and the counts of packets behind them. The counts
+    // are written by the task, and like RadarLink's, aligned 32-bit values
+    // don't tear.
+    uint32_t received() const { return frames; }
+    const StreamAssembler &counts() const { return assembler; }
+
+  private:
+    int sockets[3] = {-1, -1, -1}; // for each StreamProtocol
+    uint8_t assembly[frameSize] = {}; // the frame the packets are written to
+    StreamAssembler assembler{assembly, frameSize};
+    TripleBuffer<Frame> frame;
+    uint32_t timeoutMs = 2500;
+    std::atomic<uint32_t> frameMs{0};   // when the last frame completed
+    std::atomic<uint32_t> frames{0};    // frames published
+    std::atomic<bool> terminated{false}; // an E1.31 source said it stopped
+    Telemetry::Handle fpsHandle, lostHandle, lateHandle, incompleteHandle;
+    uint32_t reportMs = 0;     // when report() last sent telemetry
+    uint32_t reportFrames = 0; // frames completed by then
+    TaskHandle_t taskHandle = nullptr;
+
+    int listen(const char *key, uint16_t port);
+    void receive(uint8_t protocol, const uint8_t *data, size_t len);
+    void report();
+    static void task(void *param);
+};
+
+template <uint16_t N>
+bool StreamReceiver<N>::begin(const uint16_t *remap) {
+    assembler = StreamAssembler(assembly, frameSize, remap);
+    assembler.firstUniverse[streamE131] =
+        preferences.getUInt("stream_universe", 1);
+    assembler.firstUniverse[streamArtNet] =
+        preferences.getUInt("stream_artnet_universe", 0);
+    const uint32_t channels = preferences.getUInt("stream_channels", 510);
+    assembler.channels = channels < 1 ? 1 : channels > 512 ? 512 : channels;
+    if ((frameSize + assembler.channels - 1) / assembler.channels >
+        STREAM_MAX_UNIVERSES)
+        LOG_ERROR("Only the first %u universes of %u channels are received",
+                  STREAM_MAX_UNIVERSES, assembler.channels);
+    timeoutMs = preferences.getUInt("stream_timeout", 2500);
+    sockets[streamDDP] = listen("stream_ddp_port", DDP_PORT);
+    sockets[streamE131] = listen("stream_e131_port", E131_PORT);
+    sockets[streamArtNet] = listen("stream_artnet_port", ARTNET_PORT);
+    if (sockets[0] < 0 && sockets[1] < 0 && sockets[2] < 0)
+        return false;
+
+    fpsHandle = telemetry.add("stream", {.unit = "Hz", .teleplot = ""});
+    lostHandle = telemetry.add("stream lost", {.maxMs = 600000});
+    lateHandle = telemetry.add("stream late", {.maxMs = 600000});
+    incompleteHandle = telemetry.add("stream incomplete", {.maxMs = 600000});
+    xTaskCreatePinnedToCore(task, "stream rx", 4096, this,
+                            STREAM_TASK_PRIORITY, &taskHandle, 0);
+    return true;
+}
+
+// Bind a UDP socket to the port in a preference, unless it is 0
+template <uint16_t N>
+int StreamReceiver<N>::listen(const char *key, uint16_t port) {
+    port = preferences.getUInt(key, port);
+    if (!port)
+        return -1;
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&address, sizeof(address))) {
+        LOG_ERROR("Failed to listen for pixels on UDP port %u", port);
+        if (sock >= 0)
+            close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Parse a datagram in place, and publish the frame if it is now complete
+template <uint16_t N>
+void StreamReceiver<N>::receive(uint8_t protocol, const uint8_t *data,
+                                size_t len) {
+    StreamPacket packet;
+    const bool ok = streamDDP == protocol    ? ddpParse(data, len, packet)
+                    : streamE131 == protocol ? e131Parse(data, len, packet)
+                                             : artnetParse(data, len, packet);
+    if (!ok)
+        return;
+    if (packet.terminated) {
+        terminated = true;
+        return;
+    }
+    if (!assembler.receive(packet, millis()))
+        return;
+    Frame &back = frame.back();
+    memcpy(back.pixels, assembly, frameSize);
+    back.µs = micros();
+    frame.publish();
+    frameMs = millis();
+    frames++;
+    terminated = false;
+}
+
+// Send the frame rate and packet losses to Telemetry once a second
+template <uint16_t N> void StreamReceiver<N>::report() {
+    const uint32_t elapsed = millis() - reportMs;
+    if (elapsed < 1000)
+        return;
+    reportMs += elapsed;
+    const uint32_t count = assembler.frames;
+    if (count != reportFrames || active())
+        telemetry.set(fpsHandle, (count - reportFrames) * 1000.f / elapsed);
+    reportFrames = count;
+    telemetry.set(lostHandle, assembler.lost);
+    telemetry.set(lateHandle, assembler.late);
+    telemetry.set(incompleteHandle, assembler.incomplete);
+}
+
+// Wait for datagrams on any of the sockets, for up to a second at a time,
+// then take every datagram waiting on each
+template <uint16_t N> void StreamReceiver<N>::task(void *param) {
+    StreamReceiver &self = *(StreamReceiver *)param;
+    uint8_t buffer[1500];
+    for (;;) {
+        fd_set ready;
+        FD_ZERO(&ready);
+        int last = -1;
+        for (int sock : self.sockets) {
+            if (sock >= 0)
+                FD_SET(sock, &ready), last = sock > last ? sock : last;
+        }
+        struct timeval timeout = {1, 0};
+        if (select(last + 1, &ready, nullptr, nullptr, &timeout) > 0) {
+            for (uint8_t protocol = 0; protocol < 3; protocol++) {
+                const int sock = self.sockets[protocol];
+                if (sock < 0 || !FD_ISSET(sock, &ready))
+                    continue;
+                int len;
+                while ((len = recv(sock, buffer, sizeof(buffer),
+                                   MSG_DONTWAIT)) > 0)
+                    self.receive(protocol, buffer, len);
+            }
+        }
+        self.report();
+    }
+}
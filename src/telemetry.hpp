@@ -1,14 +1,37 @@
 #pragma once
 
+#include "byte_ring.hpp"
+#include "logbook.hpp"
+#include "mpsc_ring.hpp"
 #include "preferences.hpp"
+#include "telemetry_history.hpp"
+#include "telemetry_rate.hpp"
+#include "telemetry_wire.hpp"
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <time.h>
+#include <type_traits>
+#include <vector>
 #if !defined(TELEMETRYSERIALONLY)
+#include "resolver.hpp"
 #include <lwip/netdb.h>
 #include <lwip/sockets.h>
 #endif
 
+// Values which set() may queue between sends, each taking 56 bytes. Raise it
+// if "Telemetry drops" counts up.
+#if !defined(TELEMETRY_POSTS)
+#define TELEMETRY_POSTS 64
+#endif
+
+// Data which add() may register, including an aggregate's three statistics.
+// Room for them all is reserved up front, so send() can read the data while
+// add() appends to them. add() logs an error if there isn't room.
+#if !defined(TELEMETRY_DATA)
+#define TELEMETRY_DATA 192
+#endif
+
 // Return a String representing the current time
 String timeString() {
     time_t now;
@@ -20,75 +43,337 @@ String timeString() {
     return String(timeString);
 }
 
+// Format value with a fixed number of decimals (at most 6) into out, which
+// must hold 24 chars. Returns the length. Several times faster than printf,
+// and never allocates.
+size_t formatFloat(char *out, float value, uint8_t decimals = 2) {
+    static const uint32_t scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+    if (decimals > 6)
+        decimals = 6;
+    if (!isfinite(value) || fabsf(value) >= 4e9f)
+        return snprintf(out, 24, "%.*g", decimals + 1, value);
+
+    // Round to the fixed point representation, then print the digits of the
+    // whole and fractional parts backwards from the end of a scratch buffer
+    const bool negative = value < 0;
+    const uint32_t scale = scales[decimals];
+    float magnitude = fabsf(value);
+    uint32_t whole = magnitude;
+    uint32_t fraction = (magnitude - whole) * scale + 0.5f;
+    if (fraction >= scale)
+        whole++, fraction -= scale;
+    const bool minus = negative && (whole || fraction); // no "-0.00"
+
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    for (int i = 0; i < decimals; i++, fraction /= 10)
+        *--p = '0' + fraction % 10;
+    if (decimals)
+        *--p = '.';
+    do
+        *--p = '0' + whole % 10;
+    while (whole /= 10);
+    if (minus)
+        *--p = '-';
+    const size_t len = digits + sizeof(digits) - p;
+    memcpy(out, p, len);
+    out[len] = 0;
+    return len;
+}
+
 // Store Teleplot-compatible, human-readable telemetry data, where each datum
 // may have unique sending intervals, units, etc. Periodically coalesce only
 // changed values into a report. Send them over Serial without blocking and/or
 // UDP to Teleplot. Or just a terminal and/or netcat (e.g. `nc -l -u -p 47269`).
+//
+// add() looks each datum up by name. Frequently updated data should instead
+// keep the Handle returned by add() and update it with set(), which neither
+// searches nor allocates. Numbers passed to set() are stored as numbers,
+// compared against a deadband, and only formatted when sent. add() with the
+// name of an existing datum sets its value as text, as set(handle, text)
+// does, so a numeric datum becomes a text one; text longer than 47 chars is
+// truncated, and logged as an error.
+//
+// begin() starts a low-priority task on core 0 which does all the formatting
+// and I/O, so the render loop only enqueues values. set() queues a value
+// without locks or allocation, so any task, callback or ISR may call it.
+// add() takes a lock, so keep it out of ISRs and hot paths. The lock only
+// guards the lookup of names, so send() never holds it.
+//
+// With flags.binaryTelemetry, UDP telemetry is sent in the compact encoding
+// of telemetry_wire.hpp instead, for tools/teleplot_bridge to decode.
+//
+// UDP is paced by telemetry_rate.hpp, at up to the "telemetry_bps" preference.
+// When sends fail the rate is cut, and low priority data are sent less often
+// first, so critical data keep flowing.
+//
+// Every number sent, or which would have been sent were telemetry on, is
+// also kept in a compressed history in PSRAM, for /history to download.
 class Telemetry {
   public:
-    Telemetry() {};
+    typedef uint16_t Handle; // index of a datum, from add()
+    static const Handle none = 0xffff; // from add() when there's no room
+
+    Telemetry() {
+        data.reserve(TELEMETRY_DATA);
+        names.reserve(TELEMETRY_DATA);
+    };
     ~Telemetry() {};
 
+    enum Type : uint8_t { text, integer, real };
+    enum Priority : uint8_t { critical, normal, low };
+
+    // The min, max and sum of numbers set since a datum was last sent
+    struct Window {
+        float min = 0, max = 0, sum = 0;
+        uint32_t count = 0;
+
+        void add(float value) {
+            if (!count)
+                min = max = value;
+            min = fminf(min, value), max = fmaxf(max, value);
+            sum += value;
+            count++;
+        }
+        float mean() const { return count ? sum / count : 0; }
+    };
+
     // Holds the default values for a telemetry datum
     struct Datum {
-        uint32_t sentMs = 0;    // when the last update was sent
-        uint32_t minMs = 1000;  // send changes no more frequently than this
-        uint32_t maxMs = 60000; // send at least this frequently
-        String value;           // current value
-        String lastValue;       // previous value that was sent
-        String unit;            // unit of the value
-        String teleplot = "np"; // teleplot configuration flags
-        bool udpOnly = false;   // send only via UDP, never Serial
-        bool sanitise = true;   // replace :|; with Unicode characters
+        uint32_t sentMs = 0;     // when the last update was sent
+        uint32_t minMs = 1000;   // send changes no more frequently than this
+        uint32_t maxMs = 60000;  // send at least this frequently
+        String value{};          // current value
+        String lastValue{};      // previous value that was sent
+        String unit{};           // unit of the value
+        String teleplot = "np";  // teleplot configuration flags
+        bool udpOnly = false;    // send only via UDP, never Serial
+        bool sanitise = true;    // replace :|; with Unicode characters
+        float deadband = 0.005f; // ignore numeric changes no bigger than this
+        uint8_t decimals = 2;    // decimal places to send for real values
+        bool aggregate = false;  // send the mean of the numbers set every
+                                 // minMs, with their min, max and count,
+                                 // or the last ones and n 0 every maxMs
+        // Low priority data are sent less often first when UDP is congested
+        Priority priority = normal;
+
+        // Set by add() and set(), rather than when adding a datum
+        Type type = text;     // which of the values below is current
+        int32_t intValue = 0; // current value of an integer
+        int32_t sentInt = 0;  // last integer value sent
+        float realValue = 0;  // current value of a real
+        float sentReal = 0;   // last real value sent
+        Window window{};      // numbers set since last sent, if aggregate
+        Handle stats = 0;     // "<name> min", then max and n, if aggregate
+        bool isStat = false;  // one of those, sent with the mean
     };
 
-    void add(String name, const Datum &datum);
-    void add(const String name, const String value);
+    Handle add(String name, const Datum &datum);
+    Handle add(const String name, const String value);
+    bool set(Handle handle, const char *value);
+    bool set(Handle handle, float value);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, bool>::type
+    set(Handle handle, T value) {
+        return post(handle, integer, [=](Post &p) { p.intValue = value; });
+    }
     void begin();
     void send();
     void sysStats();
+    bool copyHistory(const String &name, std::vector<uint8_t> &out,
+                     uint8_t &decimals);
+    String historyIndex();
 
   private:
-    // Holds a log entry
-    struct Log {
-        uint32_t timestamp; // when the log entry was created
-        String message;     // the log entry
+    // A value from set(), waiting to be applied by send()
+    struct Post {
+        Handle handle;
+        Type type;
+        union {
+            int32_t intValue;
+            float realValue;
+            char text[48]; // null terminated, and truncated to fit
+        };
     };
+    MpscRing<Post, TELEMETRY_POSTS> posts;
+    uint32_t postDrops = 0; // posts lost because the queue was full
+    Handle postDropsHandle;
+
+    template <typename Fill> bool post(Handle handle, Type type, Fill fill);
+    void applyPosts();
+
+    TaskHandle_t taskHandle = nullptr;
+    SemaphoreHandle_t registry = nullptr;    // guards appending and lookup
+    SemaphoreHandle_t historyLock = nullptr; // guards history
+    static void task(void *param);
+    static void lock(SemaphoreHandle_t mutex) {
+        if (mutex)
+            xSemaphoreTake(mutex, portMAX_DELAY);
+    }
+    static void unlock(SemaphoreHandle_t mutex) {
+        if (mutex)
+            xSemaphoreGive(mutex);
+    }
 
-    std::map<String, Datum> data;
-    std::deque<String> serialQueue;
+    // add() appends to data and names, then publishes the new count, so
+    // send() reads the data below count without the lock. Their storage is
+    // reserved, so appending never moves the data send() is reading.
+    std::vector<Datum> data;         // indexed by Handle
+    std::vector<String> names;       // indexed by Handle
+    Handle count = 0;                // data published to send()
+    std::map<String, Handle> lookup; // name to Handle, for add()
+    Handle sysHandles[6];            // for sysStats()
+    ByteRing<8192> serialRing;       // reports waiting for Serial
+    Handle serialDropsHandle;
+    Handle coalesceHandle; // µs each coalesceChanges() takes
     std::deque<String> udpQueue;
-    std::deque<Log> logQueue;
+    TelemetryRate udpRate; // paces and meters UDP
+    TelemetryHistory history;
 
 #if !defined(TELEMETRYSERIALONLY)
-    const int udpMaxPayload = 1024; // max payload size for UDP telemetry
+    static const int udpMaxPayload = 1024; // max payload of a UDP packet
+    static const size_t udpMaxQueue = 50;  // entries kept while UDP can't send
+
     int udpSocket = -1;             // a socket for sending UDP telemetry
     struct sockaddr_in udpSockAddr; // the destination address for UDP telemetry
-    uint32_t udpSendMs = 0;         // when the last UDP telemetry was sent
+    String udpHost;                 // telemetry_host, if it must be resolved
+    uint32_t udpDrops = 0;          // entries dropped from a long udpQueue
+    struct {
+        Handle bandwidth, packets, rate, drops;
+    } udpHandles;
+
+    uint16_t session = 0;      // identifies this boot to the bridge
+    Handle dictionarySent = 0; // data below this have been described
+    uint32_t dictionaryMs = 0; // when all data were last described
+
+    void coalesceDictionary(TelemetryWriter &wire, uint32_t now, Handle n);
+    void writeBinary(TelemetryWriter &wire, Handle h, const Datum &td);
+    void queueBinary(TelemetryWriter &wire);
+    void trimUdpQueue(bool newest);
+    static bool describes(const String &entry) {
+        return entry.length() > 2 &&
+               TELEMETRY_WIRE_MAGIC == uint8_t(entry[0]) &&
+               wireDictionary == uint8_t(entry[2]);
+    }
 #endif
 
     void sanitiseValue(String &value);
+    bool changed(const Datum &td);
     bool coalesceChanges(uint32_t minMs = 200);
+    template <typename Put>
+    void formatReport(Handle h, const char *value, Put put);
     void sendSerial();
-    void sendUDP(uint32_t minMs = 200);
+    void sendUDP();
 };
 
-// Add a custom datum, or update the value if it already exists
-void Telemetry::add(String name, const Datum &datum) {
-    auto it = data.find(name);
-    if (it == data.end())
-        data.emplace(name, datum);
-    else
-        it->second.value = datum.value;
+// Add a custom datum, or set the value as text if it already exists
+Telemetry::Handle Telemetry::add(String name, const Datum &datum) {
+    lock(registry);
+    auto it = lookup.find(name);
+    if (it != lookup.end()) {
+        const Handle handle = it->second;
+        unlock(registry);
+        if (datum.value.length() >= sizeof(Post::text))
+            LOG_ERROR("Telemetry %s truncated to %u chars", name.c_str(),
+                      unsigned(sizeof(Post::text) - 1));
+        if (datum.value.length())
+            set(handle, datum.value.c_str());
+        return handle;
+    }
+    if (data.size() + (datum.aggregate ? 4 : 1) > TELEMETRY_DATA) {
+        unlock(registry);
+        LOG_ERROR("No room for telemetry %s", name.c_str());
+        return none;
+    }
+    const Handle handle = data.size();
+    data.push_back(datum);
+    names.push_back(name);
+    lookup.emplace(name, handle);
+
+    // Add the series for the window's min, max and count
+    if (datum.aggregate) {
+        const char *suffix[] = {" min", " max", " n"};
+        data[handle].stats = data.size();
+        for (int i = 0; i < 3; i++) {
+            Datum stat = datum;
+            stat.aggregate = false;
+            stat.isStat = true;
+            if (2 == i)
+                stat.unit = "";
+            lookup.emplace(name + suffix[i], data.size());
+            names.push_back(name + suffix[i]);
+            data.push_back(stat);
+        }
+    }
+    __atomic_store_n(&count, data.size(), __ATOMIC_RELEASE);
+    unlock(registry);
+    return handle;
 }
 
 // Add a default datum, or update the value if it already exists
-void Telemetry::add(const String name, const String value) {
-    auto it = data.find(name);
-    if (it == data.end())
-        data.emplace(name, Datum{.value = value});
-    else
-        it->second.value = value;
+Telemetry::Handle Telemetry::add(const String name, const String value) {
+    return add(name, Datum{.value = value});
+}
+
+// Queue a value from any task or ISR. Returns false if the queue was full.
+template <typename Fill>
+bool Telemetry::post(Handle handle, Type type, Fill fill) {
+    if (handle >= __atomic_load_n(&count, __ATOMIC_ACQUIRE))
+        return false; // none, from an add() which had no room
+    if (posts.push([&](Post &p) {
+            p.handle = handle, p.type = type;
+            fill(p);
+        }))
+        return true;
+    __atomic_fetch_add(&postDrops, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+bool Telemetry::set(Handle handle, const char *value) {
+    return post(handle, text, [=](Post &p) {
+        strncpy(p.text, value, sizeof(p.text) - 1);
+        p.text[sizeof(p.text) - 1] = 0;
+    });
+}
+
+bool Telemetry::set(Handle handle, float value) {
+    return post(handle, real, [=](Post &p) { p.realValue = value; });
+}
+
+// Apply queued values to the data, oldest first. Assigning into a text
+// datum's String only allocates if the value is longer than any before.
+void Telemetry::applyPosts() {
+    Post p;
+    while (posts.pop(p)) {
+        Datum &td = data[p.handle];
+        td.type = p.type;
+        if (integer == p.type)
+            td.intValue = p.intValue;
+        else if (real == p.type)
+            td.realValue = p.realValue;
+        else
+            td.value = p.text;
+        if (td.aggregate && text != p.type)
+            td.window.add(integer == p.type ? p.intValue : p.realValue);
+    }
+    Datum &drops = data[postDropsHandle];
+    drops.type = integer;
+    drops.intValue = __atomic_load_n(&postDrops, __ATOMIC_RELAXED);
+    Datum &serialDrops = data[serialDropsHandle];
+    serialDrops.type = integer;
+    serialDrops.intValue = serialRing.drops;
+}
+
+// Has the value changed enough to be worth sending?
+bool Telemetry::changed(const Datum &td) {
+    switch (td.type) {
+    case integer:
+        return fabsf(float(int64_t(td.intValue) - td.sentInt)) > td.deadband;
+    case real:
+        return !(fabsf(td.realValue - td.sentReal) <= td.deadband); // NaN
+    default:
+        return td.value != td.lastValue;
+    }
 }
 
 // Teleplot doesn't like :|; in values
@@ -101,129 +386,324 @@ void Telemetry::sanitiseValue(String &value) {
 // Every 200ms get changed values, format for Teleplot, and queue to be sent
 bool Telemetry::coalesceChanges(uint32_t minMs) {
     static uint32_t lastCoalesce = 0;
-    bool changed = false;
+    bool anyChanged = false;
     uint32_t now = millis();
     if (now - lastCoalesce < minMs)
-        return changed;
+        return anyChanged;
+    lastCoalesce = now;
+    const uint32_t startMicros = micros();
+    const Handle n = __atomic_load_n(&count, __ATOMIC_ACQUIRE);
 
     String udpReports{""};
-    String serialReports{""};
-    for (auto &kv : data) {
-        Datum &td = kv.second;
-        uint32_t elapsed = now - td.sentMs;
-        if (elapsed < td.maxMs) {
-            if (elapsed < td.minMs)
-                continue;
-            if (td.value == td.lastValue)
-                continue;
-        }
+    bool binary = false;
+#if !defined(TELEMETRYSERIALONLY)
+    uint8_t packet[udpMaxPayload];
+    TelemetryWriter wire(packet, sizeof(packet));
+    binary = flags.udpTelemetry && flags.binaryTelemetry;
+    if (binary) {
+        coalesceDictionary(wire, now, n);
+        wire.begin(wireValues, session);
+    }
+#endif
+
+    // Queue a datum's value for each output
+    auto report = [&](Handle h) {
+        Datum &td = data[h];
         td.sentMs = now;
-        td.lastValue = td.value;
-        changed = true;
-
-        String value = td.value;
-        if (td.sanitise)
-            sanitiseValue(value);
-        String report = kv.first + ":" + value;
-
-        if (td.unit.length())
-            report += "§" + td.unit; // U+00A7 SECTION SIGN
-        if (td.teleplot.length())
-            report += "|" + td.teleplot;
-        report += "\n";
-
-        if (flags.serialTelemetry && !td.udpOnly)
-            serialReports += ">" + report;
+        td.sentInt = td.intValue;
+        td.sentReal = td.realValue;
+        if (text == td.type)
+            td.lastValue = td.value;
+        else {
+            lock(historyLock);
+            history.add(h, now,
+                        integer == td.type ? td.intValue : td.realValue);
+            unlock(historyLock);
+        }
+
+#if !defined(TELEMETRYSERIALONLY)
+        if (binary)
+            writeBinary(wire, h, td);
+#endif
+        const bool toSerial = flags.serialTelemetry && !td.udpOnly;
+        const bool toUDP = flags.udpTelemetry && !binary;
+        if (!toSerial && !toUDP)
+            return;
+
+        // Format numbers only now they're being sent
+        char number[24];
+        const char *value = number;
+        String sanitised;
+        if (integer == td.type) {
+            snprintf(number, sizeof(number), "%ld", long(td.intValue));
+        } else if (real == td.type) {
+            formatFloat(number, td.realValue, td.decimals);
+        } else if (td.sanitise) {
+            sanitised = td.value;
+            sanitiseValue(sanitised);
+            value = sanitised.c_str();
+        } else {
+            value = td.value.c_str();
+        }
+
+        // Serial reports are formatted straight into the ring
+        if (toSerial) {
+            serialRing.start();
+            serialRing.append(">", 1);
+            formatReport(h, value, [this](const char *p, size_t n) {
+                serialRing.append(p, n);
+            });
+            serialRing.commit();
+        }
 #if !defined(TELEMETRYSERIALONLY)
-        if (flags.udpTelemetry)
-            udpReports += report;
+        if (toUDP)
+            formatReport(h, value, [&](const char *p, size_t n) {
+                udpReports.concat(p, n);
+            });
         if (udpReports.length() >= udpMaxPayload)
             udpQueue.push_back(udpReports), udpReports = "";
 
 #endif
+    };
+
+    const float stretch[] = {udpRate.stretch(critical), udpRate.stretch(normal),
+                             udpRate.stretch(low)};
+    for (Handle h = 0; h < n; h++) {
+        Datum &td = data[h];
+        if (td.isStat)
+            continue; // sent along with the mean
+        if (text == td.type && td.value.isEmpty())
+            continue; // added in advance, but nothing to say yet
+        uint32_t elapsed = now - td.sentMs;
+        const float interval = td.minMs * stretch[td.priority];
+        const bool due = elapsed >= td.maxMs * stretch[td.priority];
+        if (td.aggregate) {
+            if (elapsed < interval || (!td.window.count && !due))
+                continue;
+        } else if (!due) {
+            if (elapsed < interval)
+                continue;
+            if (!changed(td))
+                continue;
+        }
+        anyChanged = true;
+        if (!td.aggregate) {
+            report(h);
+            continue;
+        }
+
+        // Send the window as the mean, then its min, max and count. An empty
+        // window repeats the last mean, min and max, with a count of 0.
+        const Window window = td.window;
+        td.window = Window{};
+        td.type = real;
+        if (window.count)
+            td.realValue = window.mean();
+        report(h);
+        const float stats[] = {window.min, window.max};
+        for (int i = 0; i < 2; i++) {
+            data[td.stats + i].type = real;
+            if (window.count)
+                data[td.stats + i].realValue = stats[i];
+            report(td.stats + i);
+        }
+        data[td.stats + 2].type = integer;
+        data[td.stats + 2].intValue = window.count;
+        report(td.stats + 2);
     }
 
+#if !defined(TELEMETRYSERIALONLY)
+    if (binary)
+        queueBinary(wire);
+#endif
     if (udpReports.length())
         udpQueue.push_back(udpReports);
-    if (serialReports.length())
-        serialQueue.push_back(serialReports);
 
-    return changed;
+    set(coalesceHandle, micros() - startMicros);
+    return anyChanged;
 }
 
-// Send changed data over Serial and/or UDP
+// Pass the pieces of a datum's Teleplot report to put(data, length)
+template <typename Put>
+void Telemetry::formatReport(Handle h, const char *value, Put put) {
+    const Datum &td = data[h];
+    put(names[h].c_str(), names[h].length());
+    put(":", 1);
+    put(value, strlen(value));
+    if (td.unit.length()) {
+        put("§", strlen("§")); // U+00A7 SECTION SIGN
+        put(td.unit.c_str(), td.unit.length());
+    }
+    if (td.teleplot.length()) {
+        put("|", 1);
+        put(td.teleplot.c_str(), td.teleplot.length());
+    }
+    put("\n", 1);
+}
+
+#if !defined(TELEMETRYSERIALONLY)
+// Describe data the bridge hasn't heard of yet. Describe them all every 10
+// seconds too, in case the bridge restarted or a packet was lost, unless the
+// last descriptions are still waiting to be sent.
+void Telemetry::coalesceDictionary(TelemetryWriter &wire, uint32_t now,
+                                   Handle n) {
+    if (now - dictionaryMs >= 10000) {
+        dictionaryMs = now;
+        if (std::none_of(udpQueue.begin(), udpQueue.end(), describes))
+            dictionarySent = 0;
+    }
+    if (dictionarySent >= n)
+        return;
+
+    wire.begin(wireDictionary, session);
+    for (Handle h = dictionarySent; h < n; h++) {
+        const Datum &td = data[h];
+        const String &name = names[h];
+        if (!wire.fits(TelemetryWriter::dictionarySize(
+                name.length(), td.unit.length(), td.teleplot.length()))) {
+            queueBinary(wire);
+            wire.begin(wireDictionary, session);
+        }
+        wire.dictionary(h, td.decimals, name.c_str(), name.length(),
+                        td.unit.c_str(), td.unit.length(), td.teleplot.c_str(),
+                        td.teleplot.length());
+    }
+    queueBinary(wire);
+    dictionarySent = n;
+}
+
+// Append a changed value to a binary packet, queueing the packet when full
+void Telemetry::writeBinary(TelemetryWriter &wire, Handle h, const Datum &td) {
+    size_t length = td.value.length();
+    const size_t maxLength = udpMaxPayload - TELEMETRY_WIRE_HEADER -
+                             TelemetryWriter::valueSize();
+    if (length > maxLength)
+        length = maxLength;
+    if (!wire.fits(TelemetryWriter::valueSize(text == td.type ? length : 0))) {
+        queueBinary(wire);
+        wire.begin(wireValues, session);
+    }
+    if (integer == td.type)
+        wire.integer(h, td.intValue);
+    else if (real == td.type)
+        wire.real(h, td.realValue);
+    else
+        wire.text(h, td.value.c_str(), length);
+}
+
+void Telemetry::queueBinary(TelemetryWriter &wire) {
+    if (wire.empty())
+        return;
+    String packet;
+    packet.concat((const char *)wire.data(), wire.size());
+    udpQueue.push_back(packet);
+}
+
+// Drop the newest or oldest entries beyond udpMaxQueue. Values go first, as
+// the bridge can't decode any value it hasn't had described. If the queue is
+// all descriptions, drop them too, and describe every datum again.
+void Telemetry::trimUdpQueue(bool newest) {
+    while (udpQueue.size() > udpMaxQueue) {
+        udpDrops++;
+        if (newest) {
+            auto it = std::find_if_not(udpQueue.rbegin(), udpQueue.rend(),
+                                       describes);
+            if (it != udpQueue.rend()) {
+                udpQueue.erase(std::next(it).base());
+                continue;
+            }
+            udpQueue.pop_back();
+        } else {
+            auto it = std::find_if_not(udpQueue.begin(), udpQueue.end(),
+                                       describes);
+            if (it != udpQueue.end()) {
+                udpQueue.erase(it);
+                continue;
+            }
+            udpQueue.pop_front();
+        }
+        dictionarySent = 0;
+    }
+}
+#endif
+
+// Send changed data over Serial and/or UDP. The telemetry task does this
+// every 100ms; it does nothing if called from elsewhere while the task runs.
 void Telemetry::send() {
     static uint32_t lastSend = 0;
+    if (taskHandle && xTaskGetCurrentTaskHandle() != taskHandle)
+        return;
     if (millis() - lastSend < 100)
         return;
     lastSend = millis();
 
+    // Logs go to Serial whether or not telemetry does, as Teleplot shows
+    // lines without a leading '>' as logs
+    logbook.drain([this](const LogRecord &record) {
+        char line[160];
+        const size_t n = logbook.format(record, line, sizeof(line) - 1);
+        line[n] = '\n';
+        serialRing.start();
+        serialRing.append(line, n + 1);
+        serialRing.commit();
+    });
+
+    // Coalesce even when telemetry is off, to keep the history
+    applyPosts();
+    coalesceChanges();
     if (!flags.udpTelemetry && !flags.serialTelemetry) {
-        serialQueue.clear();
         udpQueue.clear();
+        sendSerial();
         return;
     }
 
-    coalesceChanges();
     sendUDP();
     sendSerial();
 }
 
-void Telemetry::sendSerial() {
-    static size_t position{0};
-    static String item{""};
-
-    // Drop oldest entries if the queue gets too long
-    while (serialQueue.size() > 10)
-        serialQueue.pop_front();
-
-    if (serialQueue.empty() || !flags.serialTelemetry)
-        if (item.isEmpty())
-            return;
+void Telemetry::task(void *param) {
+    Telemetry &self = *(Telemetry *)param;
+    for (;;) {
+        self.send();
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
 
-    // fill the outgoing buffer to capacity
+// Fill Serial's transmit buffer straight from the ring, without copying.
+// Reports that don't fit in the ring are dropped and counted by commit().
+void Telemetry::sendSerial() {
     int charsToSend = Serial.availableForWrite();
-    while (charsToSend > 0) {
-        if (item.isEmpty()) {
-            if (serialQueue.empty())
-                break;
-            item = serialQueue.front();
-            serialQueue.pop_front();
-            position = 0;
-        }
-        int chunkSize = item.length() - position;
-        if (chunkSize > charsToSend)
-            chunkSize = charsToSend;
-        Serial.print(item.substring(position, position + chunkSize));
-        position += chunkSize;
+    while (charsToSend > 0 && serialRing.size()) {
+        size_t chunkSize;
+        const char *chunk = serialRing.peek(chunkSize, charsToSend);
+        Serial.write((const uint8_t *)chunk, chunkSize);
+        serialRing.consume(chunkSize);
         charsToSend -= chunkSize;
-        if (position >= item.length())
-            item = "";
     }
 }
 
-void Telemetry::sendUDP(uint32_t minMs) {
+void Telemetry::sendUDP() {
 #if defined(TELEMETRYSERIALONLY)
     udpQueue.clear();
     return;
 #else
+    // Meter what was sent, whether or not there's more to send
+    const uint32_t now = millis();
+    udpRate.meter(now);
+    set(udpHandles.bandwidth, udpRate.bytesPerSecond);
+    set(udpHandles.packets, udpRate.packetsPerSecond);
+    set(udpHandles.rate, udpRate.rate);
+    set(udpHandles.drops, udpDrops);
     if (0 == udpQueue.size())
         return;
 
     if (!flags.wifiConnected || !flags.udpTelemetry ||
         0xffffffff == udpSockAddr.sin_addr.s_addr) {
         // Logging starts before WiFi. Queue stuff until WiFi connects.
-        while (udpQueue.size() > 50)
-            udpQueue.pop_back();
+        trimUdpQueue(true);
         return;
     }
 
-    // Cap the packets per second
-    if (!udpSendMs)
-        udpSendMs = millis();
-    if (millis() - udpSendMs < minMs)
-        return;
-
     // Create a UDP socket if it doesn't exist
     static int udpSocket = -1;
     if (udpSocket < 0) {
@@ -235,13 +715,15 @@ void Telemetry::sendUDP(uint32_t minMs) {
     }
 
     // Set up the destination address, if not already done
-    if (!udpSockAddr.sin_addr.s_addr) {
+    if (!udpSockAddr.sin_family) {
         udpSockAddr.sin_family = AF_INET;
         udpSockAddr.sin_port =
             htons(preferences.getUInt("telemetry_port", 47269));
+#if defined(LWIP_SOCKET) // lwIP has sin_len, Linux doesn't
         udpSockAddr.sin_len = sizeof(udpSockAddr);
-        String host = preferences.getString("telemetry_host", "");
-        const char *host_cstr = host.c_str();
+#endif
+        udpHost = preferences.getString("telemetry_host", "");
+        const char *host_cstr = udpHost.c_str();
         int res = inet_aton(host_cstr, &udpSockAddr.sin_addr);
         if (1 != res) {
             // try to interpret as IPv6. Untested. I'm not sure if I'm doing
@@ -250,85 +732,117 @@ void Telemetry::sendUDP(uint32_t minMs) {
                             &(((sockaddr_in6 *)&udpSockAddr)->sin6_addr));
             if (1 == res) {
                 udpSockAddr.sin_family = AF_INET6;
+#if defined(LWIP_SOCKET)
                 udpSockAddr.sin_len = sizeof(udpSockAddr);
-            } else {
-                // try to resolve it as a hostname
-                // again, I'm not sure if I'm doing this properly
-                struct hostent *hostEnt = gethostbyname(host_cstr);
-                if (NULL == hostEnt) {
-                    // Serial.printf("Failed to resolve telemetry host '%s'\n",
-                    //               host_cstr);
-                    udpSockAddr.sin_addr.s_addr = 0xffffffff;
-                    return;
-                }
-                memcpy(&udpSockAddr.sin_addr, hostEnt->h_addr_list[0],
-                       hostEnt->h_length);
-                if (hostEnt->h_addrtype == AF_INET6) {
-                    udpSockAddr.sin_family = AF_INET6;
-                    udpSockAddr.sin_len = sizeof(udpSockAddr);
-                }
+#endif
+            } else if (udpHost.isEmpty()) {
+                udpSockAddr.sin_addr.s_addr = 0xffffffff; // nowhere to send
+                return;
             }
         }
-        // Serial.printf("Sending telemetry to '%s' %s:%u\n", host_cstr,
-        //               inet_ntoa(udpSockAddr.sin_addr.s_addr),
-        //               ntohs(udpSockAddr.sin_port));
+        if (1 == res)
+            udpHost = ""; // an address, so there's nothing to resolve
     }
 
-    // Concatenate up to 1KiB of telemetry in 1 packet
-    String telemetryPacket = "";
+    // Never wait for DNS here. Keep queueing until the resolver has an
+    // answer, and keep using the old one while it refreshes it.
+    if (udpHost.length() &&
+        !resolver.resolve(udpHost.c_str(), udpSockAddr.sin_addr)) {
+        trimUdpQueue(true);
+        return;
+    }
+
+    // Send packets while the rate allows
     while (udpQueue.size() > 0) {
-        String entry = udpQueue.front();
-        if (telemetryPacket.length() + entry.length() > udpMaxPayload)
-            if (telemetryPacket.length())
+        // Concatenate up to 1KiB of telemetry in 1 packet. Binary packets
+        // are already full, and are sent alone.
+        size_t entries = 0, len = 0;
+        for (const String &entry : udpQueue) {
+            const bool binaryEntry = TELEMETRY_WIRE_MAGIC == uint8_t(entry[0]);
+            const bool full = len + entry.length() > udpMaxPayload;
+            if (entries && (binaryEntry || full))
                 break;
-        udpQueue.pop_front();
-        telemetryPacket += entry;
-    }
+            entries++, len += entry.length();
+            if (binaryEntry)
+                break;
+        }
+        if (!udpRate.allow(len, now))
+            break;
 
-    // Send the packet
-    udpSendMs = millis();
-    const char *pkt_cstr = telemetryPacket.c_str();
-    size_t len = sendto(udpSocket, pkt_cstr, telemetryPacket.length(), 0,
-                        (struct sockaddr *)&udpSockAddr, sizeof(udpSockAddr));
-    if (len <= 0)
-        return;
+        String telemetryPacket = udpQueue.front();
+        udpQueue.pop_front();
+        for (size_t i = 1; i < entries; i++) {
+            telemetryPacket += udpQueue.front();
+            udpQueue.pop_front();
+        }
 
-    // Send stats on the bandwidth used by Telemetry
-    if (false) {
-        static uint32_t udpBytes = 0;
-        static uint32_t udpPackets = 0;
-        static uint32_t udpReportms = 0;
-        udpBytes += len;
-        udpPackets++;
-        if (!udpReportms)
-            udpReportms = millis();
-
-        uint32_t elapsed = millis() - udpReportms;
-        if (elapsed >= 5000) {
-            add("UDP bandwidth",
-                {.value = String(udpBytes * 1000.f / elapsed), .unit = "B/s"});
-            add("UDP packets", {.value = String(udpPackets * 1000.f / elapsed),
-                                .unit = "pkts/s"});
-            add("UDP avg size",
-                {.value = String(udpBytes / udpPackets), .unit = "B"});
-            udpReportms = millis();
-            udpBytes = udpPackets = 0;
+        // lwIP fails when it runs out of buffers, so put the packet back,
+        // and back off
+        if (sendto(udpSocket, telemetryPacket.c_str(), len, 0,
+                   (struct sockaddr *)&udpSockAddr, sizeof(udpSockAddr)) <= 0) {
+            udpRate.failed(now);
+            udpQueue.push_front(telemetryPacket);
+            break;
         }
+        udpRate.sent(len, now);
     }
+
+    // Drop the oldest entries if the network can't keep up
+    trimUdpQueue(false);
 #endif
 }
 
 void Telemetry::begin() {
-    add("Heap Free", {.maxMs = 10000, .unit = "KiB", .teleplot = ""});
-    add("Heap Min", {.maxMs = 10000});
-    add("Heap Max", {.maxMs = 10000});
-    add("PS Free", {.maxMs = 10000, .unit = "KiB", .teleplot = ""});
-    add("PS Min", {.maxMs = 10000});
-    add("PS Max", {.maxMs = 10000});
+#if !defined(TELEMETRYSERIALONLY)
+    session = esp_random();
+#endif
+    registry = xSemaphoreCreateMutex();
+    historyLock = xSemaphoreCreateMutex();
+    logbook.begin();
+#if !defined(TELEMETRYSERIALONLY)
+    resolver.begin();
+#endif
+    // Memory statistics can wait when UDP is congested
+    const Datum stats = {.maxMs = 10000, .priority = low};
+    Datum plotted = stats;
+    plotted.unit = "KiB", plotted.teleplot = "";
+    sysHandles[0] = add("Heap Free", plotted);
+    sysHandles[1] = add("Heap Min", stats);
+    sysHandles[2] = add("Heap Max", stats);
+    sysHandles[3] = add("PS Free", plotted);
+    sysHandles[4] = add("PS Min", stats);
+    sysHandles[5] = add("PS Max", stats);
+    postDropsHandle =
+        add("Telemetry drops", {.maxMs = 600000, .priority = critical});
+    serialDropsHandle =
+        add("Serial drops", {.maxMs = 600000, .priority = critical});
+    coalesceHandle =
+        add("Coalesce", {.unit = "µs", .teleplot = "", .aggregate = true});
+#if !defined(TELEMETRYSERIALONLY)
+    udpRate.begin(preferences.getUInt("telemetry_bps", 20000));
+    const Datum meter = {.unit = "B/s", .teleplot = "", .priority = critical};
+    udpHandles.bandwidth = add("UDP bandwidth", meter);
+    udpHandles.rate = add("UDP rate", meter);
+    udpHandles.packets = add("UDP packets", {.unit = "pkts/s", .teleplot = "",
+                                             .priority = critical});
+    udpHandles.drops =
+        add("UDP drops", {.maxMs = 600000, .priority = critical});
+#endif
+    const size_t historySize = preferences.getUInt("history_kib", 2048) * 1024;
+    if (uint8_t *arena = (uint8_t *)ps_malloc(historySize))
+        history.begin(arena, historySize);
+    else
+        LOG_WARN("No PSRAM for %u KiB of telemetry history",
+                 unsigned(historySize / 1024));
     // add("Uptime", {.unit = "hours"});
     // add("Time", {.teleplot = "t,np"});
     // add("RSSI", {.unit = "dBm"});
     sysStats();
+
+#if !defined(TELEMETRY_IN_LOOP) // define to send from loop() as before
+    // Below the loop task's priority 1, on the core WiFi runs on
+    xTaskCreatePinnedToCore(task, "telemetry", 8192, this, 0, &taskHandle, 0);
+#endif
 }
 
 // Send some system statistics at most once per second each
@@ -343,22 +857,22 @@ void Telemetry::sysStats() {
 
     switch (selector++) {
     case 0:
-        add("Heap Free", String(ESP.getFreeHeap() / 1024.f));
+        set(sysHandles[0], ESP.getFreeHeap() / 1024.f);
         break;
     case 1:
-        add("Heap Min", String(ESP.getMinFreeHeap() / 1024.f));
+        set(sysHandles[1], ESP.getMinFreeHeap() / 1024.f);
         break;
     case 2:
-        add("Heap Max", String(ESP.getMaxAllocHeap() / 1024.f));
+        set(sysHandles[2], ESP.getMaxAllocHeap() / 1024.f);
         break;
     case 3:
-        add("PS Free", String(ESP.getFreePsram() / 1024.f));
+        set(sysHandles[3], ESP.getFreePsram() / 1024.f);
         break;
     case 4:
-        add("PS Min", String(ESP.getMinFreePsram() / 1024.f));
+        set(sysHandles[4], ESP.getMinFreePsram() / 1024.f);
         break;
     case 5:
-        add("PS Max", String(ESP.getMaxAllocPsram() / 1024.f));
+        set(sysHandles[5], ESP.getMaxAllocPsram() / 1024.f);
         break;
     // case 6:
     //     add("Uptime", String(millis() / 3600000.f));
@@ -374,3 +888,47 @@ void Telemetry::sysStats() {
         selector = 0;
     }
 }
+
+// Copy a datum's history in the download format of telemetry_history.hpp.
+// Returns false if there's no such datum.
+bool Telemetry::copyHistory(const String &name, std::vector<uint8_t> &out,
+                            uint8_t &decimals) {
+    lock(registry);
+    auto it = lookup.find(name);
+    const bool found = it != lookup.end();
+    const Handle h = found ? it->second : 0;
+    unlock(registry);
+    if (!found)
+        return false;
+    decimals = data[h].decimals;
+
+    // Copy a block at a time, into room reserved beforehand, so send() never
+    // waits long for the lock
+    lock(historyLock);
+    const uint32_t blocks = history.blocksOf(h);
+    unlock(historyLock);
+    out.reserve(out.size() + (blocks + 1) * HISTORY_BLOCK);
+    uint32_t cursor = 0;
+    for (bool more = true; more;) {
+        lock(historyLock);
+        more = history.copyNext(h, cursor, out);
+        unlock(historyLock);
+    }
+    return true;
+}
+
+// Say how full the history is, and list the numeric data, one per line
+String Telemetry::historyIndex() {
+    String index;
+    uint32_t used, samples;
+    lock(historyLock);
+    history.usage(used, samples);
+    unlock(historyLock);
+    index += String(samples) + " samples in " + String(used) + " of " +
+             String(history.size() / HISTORY_BLOCK) + " blocks\n";
+    const Handle n = __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+    for (Handle h = 0; h < n; h++)
+        if (text != data[h].type)
+            index += names[h] + "\n";
+    return index;
+}
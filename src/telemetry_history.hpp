@@ -0,0 +1,296 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Hours of numeric telemetry, compressed like Facebook's Gorilla: each
+// timestamp is stored as the change in the interval since the last sample,
+// and each value as the bits which differ from the last value, so a steady
+// series costs a few bits per sample. Values are stored as floats.
+//
+// Samples go into 256 byte blocks, each holding one series, which are used
+// in turn from a fixed arena, so the oldest block of all is overwritten
+// first. The first sample of a block is stored whole, so each block can be
+// decoded alone, and losing the oldest costs nothing else.
+//
+// copy() gathers one series' blocks, oldest first, in the download format:
+// each block's 16 byte header, little endian, followed by its used bytes.
+// copyNext() does the same a block at a time, so a lock can be released
+// between blocks.
+// Reader decodes that, here or on a PC. Nothing here depends on Arduino, and
+// it isn't thread-safe, so Telemetry guards it with a mutex.
+
+#define HISTORY_BLOCK 256 // bytes per block, including its header
+
+class TelemetryHistory {
+  public:
+    struct Header {
+        uint16_t series;     // a Telemetry Handle
+        uint16_t count;      // samples in the block, 0 if the block is free
+        uint16_t bits;       // bits used after the first sample
+        uint16_t reserved;   // 0
+        uint32_t firstMs;    // the first sample, stored whole
+        uint32_t firstValue; // bits of a float
+    };
+    // The last sample of a block, from which the next is encoded
+    struct Tail {
+        int32_t block = -1;   // the series' newest block, or -1 if none
+        uint32_t ms = 0;      // the last sample
+        uint32_t delta = 0;   // ms since the sample before
+        uint32_t value = 0;   // bits of the last value
+        uint8_t leading = 32; // leading zero bits of the last stored XOR
+        uint8_t trailing = 0; // trailing zero bits of the last stored XOR
+    };
+    static const uint32_t capacity = (HISTORY_BLOCK - sizeof(Header)) * 8;
+
+    // Use size bytes at arena, which should be in PSRAM
+    void begin(uint8_t *arena, size_t size) {
+        this->arena = arena;
+        blocks = size / HISTORY_BLOCK;
+        opened = 0;
+        memset(arena, 0, blocks * HISTORY_BLOCK);
+        tails.clear();
+    }
+    bool enabled() const { return blocks; }
+    size_t size() const { return blocks * HISTORY_BLOCK; }
+
+    // Append a sample. Samples of a series must be added in time order.
+    void add(uint16_t series, uint32_t ms, float value) {
+        if (!blocks)
+            return;
+        if (series >= tails.size())
+            tails.resize(series + 1);
+        Tail &tail = tails[series];
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if (tail.block < 0 || !append(tail, ms, bits))
+            open(series, ms, bits);
+    }
+
+    // Append a series' blocks to out in the download format, oldest first
+    void copy(uint16_t series, std::vector<uint8_t> &out) const {
+        uint32_t cursor = 0;
+        while (copyNext(series, cursor, out))
+            ;
+    }
+
+    // Append the series' first block from cursor on, which starts at 0, and
+    // move cursor past it. Returns false if there are no more. Blocks reused
+    // between calls are skipped, so the copy stays oldest first.
+    bool copyNext(uint16_t series, uint32_t &cursor,
+                  std::vector<uint8_t> &out) const {
+        if (opened - cursor > blocks)
+            cursor = opened - blocks; // those blocks have been reused
+        for (; cursor != opened; cursor++) {
+            const uint8_t *block = arena + cursor % blocks * HISTORY_BLOCK;
+            const Header &header = *(const Header *)block;
+            if (header.count && header.series == series) {
+                out.insert(out.end(), block,
+                           block + sizeof(Header) + (header.bits + 7) / 8);
+                cursor++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Blocks holding a series
+    uint32_t blocksOf(uint16_t series) const {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < blocks; i++) {
+            const Header &header = *(const Header *)(arena + i * HISTORY_BLOCK);
+            n += header.count && header.series == series;
+        }
+        return n;
+    }
+
+    // Blocks which hold samples, and the samples they hold
+    void usage(uint32_t &used, uint32_t &samples) const {
+        used = samples = 0;
+        for (uint32_t i = 0; i < blocks; i++) {
+            const Header &header = *(const Header *)(arena + i * HISTORY_BLOCK);
+            used += !!header.count;
+            samples += header.count;
+        }
+    }
+
+    // Decode blocks in the download format, one sample at a time
+    class Reader {
+      public:
+        Reader(const uint8_t *data, size_t size) : at(data), end(data + size) {}
+
+        bool next(uint32_t &ms, float &value) {
+            while (!left) {
+                if (end - at < ptrdiff_t(sizeof(Header)))
+                    return false;
+                memcpy(&header, at, sizeof(header));
+                bits = at + sizeof(Header);
+                at = bits + (header.bits + 7) / 8;
+                if (!header.count || at > end)
+                    return false;
+                left = header.count;
+                position = 0;
+                tail = Tail{};
+                tail.ms = header.firstMs, tail.value = header.firstValue;
+            }
+            if (left-- < header.count)
+                readSample();
+            ms = tail.ms;
+            memcpy(&value, &tail.value, sizeof(value));
+            return true;
+        }
+        uint16_t series() const { return header.series; }
+
+      private:
+        const uint8_t *at, *end;
+        const uint8_t *bits = nullptr;
+        Header header = {};
+        uint16_t left = 0; // samples left in this block
+        uint32_t position = 0;
+        Tail tail;
+
+        uint32_t get(uint8_t n) { return getBits(bits, position, n); }
+        void readSample();
+    };
+
+  private:
+    uint8_t *arena = nullptr;
+    uint32_t blocks = 0; // in the arena
+    uint32_t opened = 0; // blocks ever opened; the k'th is at k % blocks
+    std::vector<Tail> tails; // indexed by series
+
+    Header &header(int32_t block) {
+        return *(Header *)(arena + block * HISTORY_BLOCK);
+    }
+    uint8_t *data(int32_t block) {
+        return arena + block * HISTORY_BLOCK + sizeof(Header);
+    }
+
+    // Start a new block with the sample stored whole, overwriting the oldest
+    void open(uint16_t series, uint32_t ms, uint32_t value) {
+        const int32_t block = opened++ % blocks;
+        Header &old = header(block);
+        if (old.count && tails[old.series].block == block)
+            tails[old.series].block = -1; // that series lost its only block
+        memset(arena + block * HISTORY_BLOCK, 0, HISTORY_BLOCK);
+        header(block) = Header{series, 1, 0, 0, ms, value};
+        tails[series] = Tail{};
+        tails[series].block = block;
+        tails[series].ms = ms, tails[series].value = value;
+    }
+
+    // Encode a sample after the last one, unless the block is full
+    bool append(Tail &tail, uint32_t ms, uint32_t value) {
+        Header &h = header(tail.block);
+        const uint32_t delta = ms - tail.ms;
+        const int32_t dod = int32_t(delta - tail.delta);
+
+        // The interval's change: 0, or in 7, 9 or 12 bits, or all 32
+        uint32_t timeCode, timeBits;
+        if (!dod)
+            timeCode = 0, timeBits = 1;
+        else if (dod >= -64 && dod < 64)
+            timeCode = 0x2 << 7 | (dod & 0x7f), timeBits = 9;
+        else if (dod >= -256 && dod < 256)
+            timeCode = 0x6 << 9 | (dod & 0x1ff), timeBits = 12;
+        else if (dod >= -2048 && dod < 2048)
+            timeCode = 0xe << 12 | (dod & 0xfff), timeBits = 16;
+        else
+            timeCode = 0xf, timeBits = 4;
+        const bool wholeTime = 4 == timeBits;
+
+        // The value's changed bits: none, or within the last XOR's window,
+        // or with a new window
+        const uint32_t x = value ^ tail.value;
+        uint8_t leading = tail.leading, trailing = tail.trailing;
+        uint32_t valueBits = 1;
+        bool sameWindow = false;
+        if (x) {
+            const uint8_t lz = __builtin_clz(x), tz = __builtin_ctz(x);
+            sameWindow = lz >= tail.leading && tz >= tail.trailing;
+            if (!sameWindow)
+                leading = lz, trailing = tz;
+            valueBits = 2 + (sameWindow ? 0 : 10) + 32 - leading - trailing;
+        }
+
+        const uint32_t bits = timeBits + (wholeTime ? 32 : 0) + valueBits;
+        if (h.bits + bits > capacity)
+            return false;
+        uint32_t position = h.bits;
+        uint8_t *out = data(tail.block);
+        putBits(out, position, timeCode, timeBits);
+        if (wholeTime)
+            putBits(out, position, dod, 32);
+        if (!x) {
+            putBits(out, position, 0, 1);
+        } else {
+            const uint8_t meaningful = 32 - leading - trailing;
+            putBits(out, position, sameWindow ? 0x2 : 0x3, 2);
+            if (!sameWindow)
+                putBits(out, position, leading << 5 | (meaningful - 1), 10);
+            putBits(out, position, x >> trailing, meaningful);
+        }
+        h.bits = position;
+        h.count++;
+        tail.ms = ms, tail.delta = delta, tail.value = value;
+        tail.leading = leading, tail.trailing = trailing;
+        return true;
+    }
+
+    // Bits are packed most significant first
+    static void putBits(uint8_t *data, uint32_t &position, uint32_t value,
+                        uint8_t n) {
+        while (n) {
+            const uint8_t room = 8 - (position & 7);
+            const uint8_t take = n < room ? n : room;
+            n -= take;
+            const uint32_t piece = (value >> n) & ((1u << take) - 1);
+            data[position >> 3] |= piece << (room - take);
+            position += take;
+        }
+    }
+    static uint32_t getBits(const uint8_t *data, uint32_t &position,
+                            uint8_t n) {
+        uint32_t value = 0;
+        while (n) {
+            const uint8_t room = 8 - (position & 7);
+            const uint8_t take = n < room ? n : room;
+            n -= take;
+            const uint32_t byte = data[position >> 3] >> (room - take);
+            value = value << take | (byte & ((1u << take) - 1));
+            position += take;
+        }
+        return value;
+    }
+};
+
+// The inverse of append()
+inline void TelemetryHistory::Reader::readSample() {
+    // Sign extend an n bit field
+    auto extend = [](uint32_t v, uint8_t n) {
+        return int32_t(v << (32 - n)) >> (32 - n);
+    };
+    int32_t dod = 0;
+    if (!get(1))
+        dod = 0;
+    else if (!get(1))
+        dod = extend(get(7), 7);
+    else if (!get(1))
+        dod = extend(get(9), 9);
+    else if (!get(1))
+        dod = extend(get(12), 12);
+    else
+        dod = get(32);
+    tail.delta += dod;
+    tail.ms += tail.delta;
+
+    if (!get(1))
+        return; // value unchanged
+    if (get(1)) {
+        tail.leading = get(5);
+        tail.trailing = 32 - tail.leading - (get(5) + 1);
+    }
+    const uint8_t meaningful = 32 - tail.leading - tail.trailing;
+    tail.value ^= get(meaningful) << tail.trailing;
+}
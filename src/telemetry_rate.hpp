@@ -0,0 +1,96 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Paces UDP telemetry with a token bucket whose rate adapts like TCP's
+// congestion window: it grows steadily while sends succeed, and halves when
+// sendto() fails, at most once per backoffMs. stretch() tells Telemetry how
+// much to lengthen each priority's send interval while the rate is cut, so
+// low priority data slow down first. It also meters what was actually sent.
+// Nothing here depends on Arduino.
+
+class TelemetryRate {
+  public:
+    float maxRate = 20000;    // bytes/s, when nothing is failing
+    float minRate = 1000;     // bytes/s, however bad things get
+    float rate = 20000;       // bytes/s allowed now
+    float increase = 2000;    // bytes/s added per second without failures
+    uint32_t backoffMs = 500; // least time between rate cuts
+
+    // Sent over the last second or so
+    float bytesPerSecond = 0;
+    float packetsPerSecond = 0;
+    uint32_t failures = 0; // sendto() failures, ever
+
+    void begin(float bytesPerSecond) {
+        maxRate = rate = bytesPerSecond;
+        if (minRate > maxRate)
+            minRate = maxRate;
+    }
+
+    // May a packet of this size be sent now?
+    bool allow(size_t bytes, uint32_t now) {
+        refill(now);
+        if (tokens < bytes)
+            return false;
+        tokens -= bytes;
+        return true;
+    }
+
+    void sent(size_t bytes, uint32_t now) {
+        meterBytes += bytes;
+        meterPackets++;
+        meter(now);
+    }
+
+    // The packet wasn't sent, so the network or lwIP is struggling
+    void failed(uint32_t now) {
+        failures++;
+        tokens = 0;
+        if (now - cutMs < backoffMs)
+            return;
+        cutMs = now;
+        rate = fmaxf(minRate, rate / 2);
+    }
+
+    // Update the meter, if a second has passed
+    void meter(uint32_t now) {
+        const uint32_t elapsed = now - meterMs;
+        if (elapsed < 1000)
+            return;
+        bytesPerSecond = meterBytes * 1000.f / elapsed;
+        packetsPerSecond = meterPackets * 1000.f / elapsed;
+        meterBytes = meterPackets = 0;
+        meterMs = now;
+    }
+
+    // How many times longer than usual each priority should wait between
+    // sends. Critical (0) never waits longer; normal (1) waits in proportion
+    // to the cut in rate; low (2) waits in proportion to its square.
+    float stretch(uint8_t priority) const {
+        const float cut = maxRate / rate;
+        if (0 == priority)
+            return 1;
+        return fminf(1 == priority ? cut : cut * cut, 64);
+    }
+
+  private:
+    float tokens = 0;
+    uint32_t refillMs = 0;
+    uint32_t cutMs = 0;
+    uint32_t meterMs = 0;
+    uint32_t meterBytes = 0;
+    uint32_t meterPackets = 0;
+
+    // Bursts of up to 200ms of data, but always room for 2 full packets
+    float burst() const { return fmaxf(rate / 5, 2048); }
+
+    void refill(uint32_t now) {
+        const float seconds = (now - refillMs) / 1000.f;
+        refillMs = now;
+        if (now - cutMs >= backoffMs)
+            rate = fminf(maxRate, rate + increase * seconds);
+        tokens = fminf(burst(), tokens + rate * seconds);
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A compact binary encoding of telemetry, as an alternative to Teleplot text
+// over UDP. Names, units and Teleplot flags are sent once in dictionary
+// packets, then each value is sent as a varint of its handle and type followed
+// by the value itself. tools/teleplot_bridge.cpp turns it back into Teleplot
+// text on a PC. Nothing here depends on Arduino.
+//
+// Every packet starts with a header:
+//   magic (0xb7, never the first byte of UTF-8 text), version, kind,
+//   session (uint16, random at boot, so stale dictionaries can be dropped)
+// A dictionary packet then holds entries of:
+//   varint handle, decimals for reals, then name, unit and teleplot flags,
+//   each as varint length + bytes
+// A values packet holds entries of:
+//   varint (handle << 2 | type), then for each type:
+//   integer: zigzag varint; real: float, little-endian; text: length + bytes
+
+#define TELEMETRY_WIRE_MAGIC 0xb7
+#define TELEMETRY_WIRE_VERSION 1
+#define TELEMETRY_WIRE_HEADER 5
+
+enum TelemetryWireKind : uint8_t { wireDictionary = 1, wireValues = 2 };
+enum TelemetryWireType : uint8_t { wireText, wireInteger, wireReal };
+
+// Appends to a fixed buffer. Check fits() before each entry, and start a new
+// packet if it doesn't.
+class TelemetryWriter {
+  public:
+    TelemetryWriter(uint8_t *buffer, size_t size) : buf(buffer), cap(size) {}
+
+    void begin(TelemetryWireKind kind, uint16_t session) {
+        len = 0;
+        byte(TELEMETRY_WIRE_MAGIC), byte(TELEMETRY_WIRE_VERSION), byte(kind);
+        byte(session), byte(session >> 8);
+    }
+    size_t size() const { return len; }
+    const uint8_t *data() const { return buf; }
+    bool empty() const { return len <= TELEMETRY_WIRE_HEADER; }
+    bool fits(size_t bytes) const { return len + bytes <= cap; }
+
+    // Upper bounds of the space an entry needs
+    static size_t dictionarySize(size_t name, size_t unit, size_t teleplot) {
+        return 5 + 1 + 5 + name + 5 + unit + 5 + teleplot;
+    }
+    static size_t valueSize(size_t text = 0) { return 5 + 5 + text; }
+
+    void dictionary(uint32_t handle, uint8_t decimals, const char *name,
+                    size_t nameLen, const char *unit, size_t unitLen,
+                    const char *teleplot, size_t teleplotLen) {
+        varint(handle);
+        byte(decimals);
+        string(name, nameLen), string(unit, unitLen);
+        string(teleplot, teleplotLen);
+    }
+    void integer(uint32_t handle, int32_t value) {
+        varint(handle << 2 | wireInteger);
+        varint(uint32_t(value) << 1 ^ uint32_t(value >> 31)); // zigzag
+    }
+    void real(uint32_t handle, float value) {
+        varint(handle << 2 | wireReal);
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        byte(bits), byte(bits >> 8), byte(bits >> 16), byte(bits >> 24);
+    }
+    void text(uint32_t handle, const char *value, size_t valueLen) {
+        varint(handle << 2 | wireText);
+        string(value, valueLen);
+    }
+
+  private:
+    uint8_t *buf;
+    size_t cap;
+    size_t len = 0;
+
+    void byte(uint8_t b) { buf[len++] = b; }
+    void varint(uint32_t v) {
+        for (; v >= 0x80; v >>= 7)
+            byte(v | 0x80);
+        byte(v);
+    }
+    void string(const char *s, size_t n) {
+        varint(n);
+        memcpy(buf + len, s, n);
+        len += n;
+    }
+};
+
+// Reads a packet written by TelemetryWriter. Any read past the end clears ok.
+class TelemetryReader {
+  public:
+    TelemetryReader(const uint8_t *data, size_t size)
+        : p(data), end(data + size) {}
+
+    bool ok = true;
+    TelemetryWireKind kind = TelemetryWireKind(0);
+    uint16_t session = 0;
+
+    // Check the header. Returns false if this isn't a packet we understand.
+    bool begin() {
+        if (end - p < TELEMETRY_WIRE_HEADER || p[0] != TELEMETRY_WIRE_MAGIC ||
+            p[1] != TELEMETRY_WIRE_VERSION)
+            return false;
+        kind = TelemetryWireKind(p[2]);
+        session = p[3] | p[4] << 8;
+        p += TELEMETRY_WIRE_HEADER;
+        return true;
+    }
+    bool more() const { return ok && p < end; }
+
+    uint8_t byte() {
+        if (p >= end)
+            return ok = false;
+        return *p++;
+    }
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35 && ok; shift += 7) {
+            uint8_t b = byte();
+            v |= uint32_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+    int32_t zigzag() {
+        uint32_t v = varint();
+        return int32_t(v >> 1 ^ -(v & 1));
+    }
+    float real() {
+        uint32_t bits = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+            bits |= uint32_t(byte()) << shift;
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    // Returns a pointer into the packet, which isn't null terminated
+    const char *string(size_t &n) {
+        n = varint();
+        if (!ok || n > size_t(end - p))
+            return ok = false, n = 0, "";
+        const char *s = (const char *)p;
+        p += n;
+        return s;
+    }
+
+  private:
+    const uint8_t *p;
+    const uint8_t *end;
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+
+// The LD2450 reports at about 10Hz, but we render at well over 100Hz. Follow
+// each target with an alpha-beta filter, so its position and velocity can be
+// predicted smoothly at any render time.
+
+#define TRACKER_MAX_TRACKS 3
+
+// A target position from one radar report, in mm
+struct Detection {
+    float x;
+    float y;
+};
+
+// The filtered state of one target
+struct Track {
+    bool active = false;     // false if this slot is free
+    float x = 0, y = 0;      // position in mm at updateMs
+    float vx = 0, vy = 0;    // velocity in mm/s
+    uint32_t updateMs = 0;   // when a detection last updated this track
+    uint32_t movingMs = 0;   // when the target was last seen moving
+    uint16_t detections = 0; // number of detections associated so far
+};
+
+class RadarTracker {
+  public:
+    float alpha = 0.5f;          // position gain
+    float beta = 0.2f;           // velocity gain
+    float gateMm = 1000;         // max distance to associate a detection
+    float movingMmPerS = 50;     // speed above which a target is moving
+    uint32_t timeoutMs = 2000;   // drop tracks with no detections for this long
+    uint32_t maxPredictMs = 500; // don't extrapolate further than this
+
+    Track tracks[TRACKER_MAX_TRACKS];
+
+    void update(uint32_t ms, const Detection *detections, uint8_t count);
+    bool predict(uint8_t i, uint32_t ms, float &x, float &y) const;
+};
+
+// Associate a report's detections with existing tracks, nearest first, then
+// update those tracks, start new ones, and drop any that have timed out
+void RadarTracker::update(uint32_t ms, const Detection *detections,
+                          uint8_t count) {
+    bool trackUsed[TRACKER_MAX_TRACKS] = {};
+    bool detectionUsed[TRACKER_MAX_TRACKS] = {};
+    if (count > TRACKER_MAX_TRACKS)
+        count = TRACKER_MAX_TRACKS;
+
+    for (;;) {
+        int bestTrack = -1, bestDetection = -1;
+        float bestDist = gateMm * gateMm;
+        for (int t = 0; t < TRACKER_MAX_TRACKS; t++) {
+            if (!tracks[t].active || trackUsed[t])
+                continue;
+            float px, py;
+            predict(t, ms, px, py);
+            for (int d = 0; d < count; d++) {
+                if (detectionUsed[d])
+                    continue;
+                float dx = detections[d].x - px, dy = detections[d].y - py;
+                float dist = dx * dx + dy * dy;
+                if (dist < bestDist)
+                    bestDist = dist, bestTrack = t, bestDetection = d;
+            }
+        }
+        if (bestTrack < 0)
+            break;
+        trackUsed[bestTrack] = detectionUsed[bestDetection] = true;
+
+        // Alpha-beta filter, from the same capped prediction as predict().
+        // Reports with the same timestamp as the last, or older, only
+        // correct the position, as there's no time to spread the velocity
+        // correction over.
+        Track &track = tracks[bestTrack];
+        const Detection &det = detections[bestDetection];
+        const int32_t elapsed = ms - track.updateMs;
+        float px, py;
+        predict(bestTrack, ms, px, py);
+        float rx = det.x - px, ry = det.y - py;
+        track.x = px + alpha * rx;
+        track.y = py + alpha * ry;
+        if (elapsed > 0) {
+            const float dt = elapsed / 1000.f;
+            track.vx += beta * rx / dt;
+            track.vy += beta * ry / dt;
+            track.updateMs = ms;
+        }
+        track.detections++;
+        if (hypotf(track.vx, track.vy) >= movingMmPerS)
+            track.movingMs = ms;
+    }
+
+    // Start tracks for unassociated detections
+    for (int d = 0; d < count; d++) {
+        if (detectionUsed[d])
+            continue;
+        for (int t = 0; t < TRACKER_MAX_TRACKS; t++) {
+            if (tracks[t].active)
+                continue;
+            tracks[t] = Track();
+            tracks[t].active = true;
+            tracks[t].x = detections[d].x;
+            tracks[t].y = detections[d].y;
+            tracks[t].updateMs = ms;
+            tracks[t].detections = 1;
+            break;
+        }
+    }
+
+    for (int t = 0; t < TRACKER_MAX_TRACKS; t++)
+        if (tracks[t].active && ms - tracks[t].updateMs > timeoutMs)
+            tracks[t].active = false;
+}
+
+// Predict where track i is at time ms. Returns false if the slot is free.
+bool RadarTracker::predict(uint8_t i, uint32_t ms, float &x, float &y) const {
+    const Track &track = tracks[i];
+    if (!track.active)
+        return false;
+    uint32_t elapsed = ms - track.updateMs;
+    if (int32_t(elapsed) < 0)
+        elapsed = 0;
+    if (elapsed > maxPredictMs)
+        elapsed = maxPredictMs;
+    x = track.x + track.vx * elapsed / 1000.f;
+    y = track.y + track.vy * elapsed / 1000.f;
+    return true;
+}
@@ -3,6 +3,7 @@
 #include "wifi.hpp"
 #include <ESPAsyncWebServer.h>
 #include <ElegantOTA.h>
+#include <LittleFS.h>
 
 const char* indexContent = 
 /* html */
@@ -20,8 +21,13 @@ R"raw_literal_html(
   <button id="telemetryoff">Serial telemetry off</button>
   <button id="UDPtelemetryon">UDP telemetry on</button>
   <button id="UDPtelemetryoff">UDP telemetry off</button>
+  <button id="benchmark">Benchmark</button>
   <button id="updateButton">OTA Update</button>
   <div id="responsediv"></div>
+  <div id="previewdiv">
+    <canvas id="preview"></canvas><br>
+    <button id="record">Record</button>
+  </div>
   <div id="updatediv">
   <iframe id="updateframe">
   </iframe></div>
@@ -71,6 +77,15 @@ R"raw_literal_css(
     height: 0px;
     overflow: hidden !important;
   }
+  #previewdiv {
+    display: none;
+    margin: 10px;
+  }
+  #preview {
+    width: 320px;
+    image-rendering: pixelated;
+    background-color: #000000;
+  }
   #updateframe {
     width: 100%;
     height: 100%;
@@ -102,12 +117,86 @@ R"raw_literal_js(
       .catch(error => console.error('Error:', error));
   }
 
+  // Show leds[] as the matrix is laid out. The server sends the XYMap as
+  // JSON, then frames coded by frame_delta.hpp: each XORs runs of bytes into
+  // the last frame. Recordings are raw frames, for tools/preview_bench.
+  function startPreview() {
+    const canvas = document.getElementById('preview');
+    const context = canvas.getContext('2d');
+    let geometry = null, frame = null, image = null, recording = null;
+    const socket = new WebSocket(`ws://${location.host}/preview`);
+    socket.binaryType = 'arraybuffer';
+    socket.onclose = () => setTimeout(startPreview, 5000);
+    socket.onmessage = (event) => {
+      if (typeof event.data === 'string') {
+        geometry = JSON.parse(event.data);
+        canvas.width = geometry.width;
+        canvas.height = geometry.height;
+        image = context.createImageData(geometry.width, geometry.height);
+        frame = null;
+        document.getElementById('previewdiv').style.display = 'block';
+        return;
+      }
+      const bytes = new Uint8Array(event.data);
+      const size = bytes[2] | bytes[3] << 8;
+      if (!geometry || (bytes[0] !== 1 && !frame))
+        return; // wait for a key frame
+      if (bytes[0] === 1)
+        frame = new Uint8Array(size);
+      let at = 0, i = 4;
+      const varint = () => {
+        let value = 0;
+        for (let shift = 0; i < bytes.length; shift += 7) {
+          const b = bytes[i++];
+          value |= (b & 0x7f) << shift;
+          if (!(b & 0x80))
+            break;
+        }
+        return value;
+      };
+      while (i < bytes.length) {
+        at += varint();
+        for (let count = varint(); count--; )
+          frame[at++] ^= bytes[i++];
+      }
+      if (recording)
+        recording.push(frame.slice());
+
+      // Row 0 of the XYMap is the bottom of the matrix
+      const { width, height, map } = geometry;
+      for (let y = 0; y < height; y++)
+        for (let x = 0; x < width; x++) {
+          const from = map[y * width + x] * 3;
+          const to = ((height - 1 - y) * width + x) * 4;
+          image.data.set(frame.subarray(from, from + 3), to);
+          image.data[to + 3] = 255;
+        }
+      context.putImageData(image, 0, 0);
+    };
+
+    document.getElementById('record').onclick = (event) => {
+      if (!recording) {
+        recording = [];
+        event.target.innerText = 'Stop';
+        return;
+      }
+      const link = document.createElement('a');
+      link.href = URL.createObjectURL(new Blob(recording));
+      link.download = 'preview.rgb';
+      link.click();
+      recording = null;
+      event.target.innerText = 'Record';
+    };
+  }
+
   document.addEventListener('DOMContentLoaded', (event) => {
+    startPreview();
     document.getElementById('restart').onclick = () => sendRequest('/restart');
     document.getElementById('telemetryon').onclick = () => sendRequest('/telemetryon');
     document.getElementById('telemetryoff').onclick = () => sendRequest('/telemetryoff');
     document.getElementById('UDPtelemetryon').onclick = () => sendRequest('/UDPtelemetryon');
     document.getElementById('UDPtelemetryoff').onclick = () => sendRequest('/UDPtelemetryoff');
+    document.getElementById('benchmark').onclick = () => sendRequest('/benchmark');
     document.getElementById('updateButton').onclick = () => {
       const updateDiv = document.getElementById('updatediv');
       if (updateDiv.style.height != '400px') {
@@ -125,6 +214,100 @@ R"raw_literal_js(
 )raw_literal_js";
 
 
+// Stream a datum's history as CSV, decoding a little per chunk, or as the
+// compressed blocks, for tools/history_bench to decode. Without a name, say
+// which data have a history.
+void serveHistory(AsyncWebServerRequest *request)
+{
+  const AsyncWebParameter *name = request->getParam("name");
+  if (!name)
+  {
+    request->send(200, "text/plain", telemetry.historyIndex());
+    return;
+  }
+  struct Download
+  {
+    std::vector<uint8_t> blocks;
+    TelemetryHistory::Reader reader{nullptr, 0};
+    uint8_t decimals = 2;
+    int64_t epochMs = 0; // millis() plus this is Unix time, if it's known
+    char line[64];
+    size_t length = 0, at = 0; // of line, and how much of it is sent
+  };
+  auto download = std::make_shared<Download>();
+  if (!telemetry.copyHistory(name->value(), download->blocks,
+                             download->decimals))
+  {
+    request->send(404, "text/plain", "No such datum");
+    return;
+  }
+
+  const AsyncWebParameter *format = request->getParam("format");
+  const bool binary = format && format->value() == "bin";
+  AsyncWebServerResponse *response;
+  if (binary)
+  {
+    response = request->beginChunkedResponse(
+        "application/octet-stream",
+        [download](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+          const size_t size = download->blocks.size();
+          const size_t n = index < size ? min(maxLen, size - index) : 0;
+          memcpy(buffer, download->blocks.data() + index, n);
+          return n;
+        });
+  }
+  else
+  {
+    download->reader = TelemetryHistory::Reader(download->blocks.data(),
+                                                download->blocks.size());
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    if (now.tv_sec > 1600000000) // the clock has been set
+      download->epochMs = now.tv_sec * 1000LL + now.tv_usec / 1000 - millis();
+    download->length = strlcpy(download->line, "ms,time,value\n",
+                               sizeof(download->line));
+    response = request->beginChunkedResponse(
+        "text/csv",
+        [download](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+          Download &d = *download;
+          size_t n = 0;
+          while (n < maxLen)
+          {
+            if (d.at == d.length)
+            {
+              uint32_t ms;
+              float value;
+              if (!d.reader.next(ms, value))
+                break;
+              char number[24];
+              formatFloat(number, value, d.decimals);
+              d.length = snprintf(d.line, sizeof(d.line), "%lu,",
+                                  (unsigned long)ms);
+              if (d.epochMs)
+              {
+                const int64_t epochMs = d.epochMs + ms;
+                d.length += snprintf(d.line + d.length, 16, "%lu.%03u",
+                                     (unsigned long)(epochMs / 1000),
+                                     unsigned(epochMs % 1000));
+              }
+              d.length += snprintf(d.line + d.length, 26, ",%s\n", number);
+              d.at = 0;
+            }
+            const size_t chunk = min(d.length - d.at, maxLen - n);
+            memcpy(buffer + n, d.line + d.at, chunk);
+            n += chunk, d.at += chunk;
+          }
+          return n;
+        });
+  }
+  response->addHeader("Content-Disposition",
+                      "attachment; filename=\"" + name->value() +
+                          (binary ? ".bin\"" : ".csv\""));
+  request->send(response);
+}
+
 void setupWebServer() {
   // Set up web server and OTA updates
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
@@ -148,6 +331,17 @@ void setupWebServer() {
             { flags.udpTelemetry = false;
               preferences.putBool("udpTelemetry", false);
               request->send(200, "text/plain", "UDP telemetry off"); });
+  server.on("/benchmark", HTTP_GET, [](AsyncWebServerRequest *request)
+            { flags.benchmarkPending = true;
+              request->send(200, "text/plain", "Benchmark results will be sent via Serial"); });
+  server.serveStatic("/radar.cap", LittleFS, "/radar.cap");
+  server.on("/logs", HTTP_GET, [](AsyncWebServerRequest *request)
+            { const AsyncWebParameter *page = request->getParam("page");
+              request->send(200, "text/plain",
+                            logbook.page(page ? page->value().toInt() : 0)); });
+  server.on("/history", HTTP_GET, serveHistory);
+
+  preview.begin(server, xyMap);
 
   ElegantOTA.begin(&server);
   ElegantOTA.onStart(onOTAStart);
@@ -17,7 +17,41 @@ const char *wifiEventName(WiFiEvent_t event);
 const char *wifiAuthModeName(wifi_auth_mode_t mode);
 AsyncWebServer server(80);
 
+// The WiFi, SNTP and OTA callbacks run on other tasks, so they only set()
+// data added by setupWiFi() before any callback can run
+struct {
+    Telemetry::Handle ip, gateway, mask, dns1, dns2, hostname, mac, ssid;
+    Telemetry::Handle ntpServer, ntpUpdated, otaProgress;
+} wifiTelemetry;
+
+void addWiFiTelemetry() {
+    wifiTelemetry.ip =
+        telemetry.add("WiFi IP", {.maxMs = 120000, .teleplot = "t,np"});
+    wifiTelemetry.gateway =
+        telemetry.add("WiFi Gateway", {.maxMs = 121100, .teleplot = "t,np"});
+    wifiTelemetry.mask =
+        telemetry.add("WiFi Mask", {.maxMs = 122200, .teleplot = "t,np"});
+    wifiTelemetry.dns1 =
+        telemetry.add("WiFi DNS1", {.maxMs = 123300, .teleplot = "t,np"});
+    wifiTelemetry.dns2 =
+        telemetry.add("WiFi DNS2", {.maxMs = 124400, .teleplot = "t,np"});
+    wifiTelemetry.hostname =
+        telemetry.add("WiFi Hostname", {.maxMs = 125500, .teleplot = "t,np"});
+    wifiTelemetry.mac =
+        telemetry.add("WiFi MAC", {.maxMs = 126600, .teleplot = "t,np"});
+    wifiTelemetry.ssid =
+        telemetry.add("WiFi SSID", {.maxMs = 127700, .teleplot = "t,np"});
+    wifiTelemetry.ntpServer =
+        telemetry.add("NTP server", {.maxMs = 900000, .teleplot = "t,np"});
+    wifiTelemetry.ntpUpdated =
+        telemetry.add("NTP updated", {.maxMs = 909909, .teleplot = "t,np"});
+    wifiTelemetry.otaProgress = telemetry.add(
+        "OTA progress", {.minMs = 250, .maxMs = 908908, .teleplot = "t"});
+}
+
 void setupWiFi() {
+    addWiFiTelemetry();
+
     if ((!preferences.isKey("wifi_ssid")) ||
         (!preferences.isKey("wifi_password")) ||
         (!preferences.isKey("wifi_hostname"))) {
@@ -64,29 +98,14 @@ void setupWiFi() {
 
 // Log current network details
 void logNetworkDetails() {
-    telemetry.add("WiFi IP", {.maxMs = 120000,
-                              .value = WiFi.localIP().toString(),
-                              .teleplot = "t,np"});
-    telemetry.add("WiFi Gateway", {.maxMs = 121100,
-                                   .value = WiFi.gatewayIP().toString(),
-                                   .teleplot = "t,np"});
-    telemetry.add("WiFi Mask", {.maxMs = 122200,
-                                .value = WiFi.subnetMask().toString(),
-                                .teleplot = "t,np"});
-    telemetry.add("WiFi DNS1", {.maxMs = 123300,
-                                .value = WiFi.dnsIP().toString(),
-                                .teleplot = "t,np"});
-    telemetry.add("WiFi DNS2", {.maxMs = 124400,
-                                .value = WiFi.dnsIP(1).toString(),
-                                .teleplot = "t,np"});
-    telemetry.add("WiFi Hostname", {.maxMs = 125500,
-                                    .value = String(WiFi.getHostname()),
-                                    .teleplot = "t,np"});
-    telemetry.add(
-        "WiFi MAC",
-        {.maxMs = 126600, .value = WiFi.macAddress(), .teleplot = "t,np"});
-    telemetry.add("WiFi SSID",
-                  {.maxMs = 127700, .value = WiFi.SSID(), .teleplot = "t,np"});
+    telemetry.set(wifiTelemetry.ip, WiFi.localIP().toString().c_str());
+    telemetry.set(wifiTelemetry.gateway, WiFi.gatewayIP().toString().c_str());
+    telemetry.set(wifiTelemetry.mask, WiFi.subnetMask().toString().c_str());
+    telemetry.set(wifiTelemetry.dns1, WiFi.dnsIP().toString().c_str());
+    telemetry.set(wifiTelemetry.dns2, WiFi.dnsIP(1).toString().c_str());
+    telemetry.set(wifiTelemetry.hostname, WiFi.getHostname());
+    telemetry.set(wifiTelemetry.mac, WiFi.macAddress().c_str());
+    telemetry.set(wifiTelemetry.ssid, WiFi.SSID().c_str());
 }
 
 // Set NTP time sync and timezone
@@ -101,28 +120,19 @@ void ntpSetup() {
     else if (ip6addr_aton(ntp1_str, &ntp.u_addr.ip6))
         ntp.type = IPADDR_TYPE_V6, esp_sntp_setserver(0, &ntp);
     else {
-        // Serial.printf("Resolving NTP server %s\n", ntp1_str);
-        struct hostent *he = gethostbyname(ntp1_str);
-        if (he != NULL) {
-            ntp.u_addr.ip4.addr = ((struct in_addr *)(he->h_addr))->s_addr;
-            ntp.type = IPADDR_TYPE_V4;
-            // Serial.printf("NTP server %s resolved to %s\n", ntp1_str,
-            // ipaddr_ntoa(&ntp));
-            esp_sntp_setserver(0, &ntp);
-        } else {
-            Serial.printf("Failed to resolve NTP server %s\n", ntp1_str);
-        }
+        // SNTP resolves the name itself, without blocking, on every poll.
+        // The name must outlive this function.
+        static String ntpName;
+        ntpName = ntp1;
+        esp_sntp_setservername(0, ntpName.c_str());
+        telemetry.set(wifiTelemetry.ntpServer, ntp1_str);
     }
     const ip_addr_t *ntp_ip = esp_sntp_getserver(0);
-    if (ntp_ip->type == IPADDR_TYPE_V4)
-        telemetry.add("NTP server", {.maxMs = 900000,
-                                     .value = String(ipaddr_ntoa(ntp_ip)),
-                                     .teleplot = "t,np"});
+    if (ntp_ip->type == IPADDR_TYPE_V4 && ntp_ip->u_addr.ip4.addr)
+        telemetry.set(wifiTelemetry.ntpServer, ipaddr_ntoa(ntp_ip));
     else if (ntp_ip->type == IPADDR_TYPE_V6)
-        telemetry.add("NTP server",
-                      {.maxMs = 900000,
-                       .value = String(ip6addr_ntoa(&ntp_ip->u_addr.ip6)),
-                       .teleplot = "t,np"});
+        telemetry.set(wifiTelemetry.ntpServer,
+                      ip6addr_ntoa(&ntp_ip->u_addr.ip6));
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
     sntp_set_sync_interval(900000); // 15 minutes
@@ -137,14 +147,11 @@ void ntpSetup() {
 }
 
 void ntpCallback(timeval *tv) {
-    telemetry.add("NTP updated",
-                  {.maxMs = 909909, .value = timeString(), .teleplot = "t,np"});
+    telemetry.set(wifiTelemetry.ntpUpdated, timeString().c_str());
 }
 
 void onOTAStart() {
-    telemetry.add(
-        "OTA progress",
-        {.minMs = 250, .maxMs = 908908, .value = "0%", .teleplot = "t"});
+    telemetry.set(wifiTelemetry.otaProgress, "0%");
     // brightness.setValue(4);
 }
 
@@ -154,17 +161,20 @@ void onOTAProgress(size_t current, size_t final) {
     int new_percent = (current * 100llu / final / step) * step;
     if (new_percent != percent) {
         percent = new_percent;
-        telemetry.add("OTA progress", String(new_percent) + "%" + " of " +
-                                          String(final) + " bytes");
+        char progress[48];
+        snprintf(progress, sizeof(progress), "%d%% of %u bytes", new_percent,
+                 unsigned(final));
+        telemetry.set(wifiTelemetry.otaProgress, progress);
     }
 }
 
 void onOTAEnd(bool success) {
     if (success) {
-        telemetry.add("OTA progress", "100\% Success");
+        telemetry.set(wifiTelemetry.otaProgress, "100% Success");
         preferences.end();
+        logbook.flush();
     } else
-        telemetry.add("OTA progress", "Failed");
+        telemetry.set(wifiTelemetry.otaProgress, "Failed");
 }
 
 // React to, and print information about, a WiFi event
@@ -223,6 +233,8 @@ void wifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
     if (prev_wifi_connected != flags.wifiConnected) {
         flags.doConnectActions = true;
         logNetworkDetails();
+        if (flags.wifiConnected)
+            resolver.refresh(); // perhaps a different network, or DNS server
         if (!flags.firstConnect) {
             flags.firstConnect = true;
             ntpSetup();
@@ -0,0 +1,68 @@
+// blendBytes(), against the scalar formula it implements
+#include "blend_bytes.hpp"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+uint8_t expected(uint8_t src, uint8_t dst, uint16_t f) {
+    return (src * (256 - f) + dst * f) >> 8;
+}
+
+// Every weight, on every alignment and length, including the bytes either
+// side of the words
+void test_matches_scalar() {
+    alignas(4) uint8_t src[80], dst[80], before[80];
+    for (uint8_t i = 0; i < sizeof(src); i++)
+        src[i] = i * 37 + 11, before[i] = i * 101 + 3;
+    for (uint16_t f = 0; f <= 256; f += 3)
+        for (uint8_t offset = 0; offset < 4; offset++)
+            for (uint8_t len = 0; len <= 67; len++) {
+                memcpy(dst, before, sizeof(dst));
+                blendBytes(src + offset, dst + offset, len, f);
+                for (uint8_t i = 0; i < sizeof(dst); i++) {
+                    const bool in = i >= offset && i < offset + len;
+                    TEST_ASSERT_EQUAL(in ? expected(src[i], before[i], f)
+                                         : before[i],
+                                      dst[i]);
+                }
+            }
+}
+
+// Buffers misaligned with each other go byte by byte, and give the same
+void test_mismatched_alignment() {
+    alignas(4) uint8_t src[40], dst[41], word[40];
+    for (uint8_t i = 0; i < 40; i++)
+        src[i] = 255 - i * 5, dst[i + 1] = word[i] = i * 6;
+    blendBytes(src, dst + 1, 40, 100);
+    blendBytes(src, word, 40, 100);
+    TEST_ASSERT_EQUAL_MEMORY(word, dst + 1, 40);
+}
+
+void test_ends() {
+    alignas(4) uint8_t src[12], dst[12];
+    memset(src, 200, 12), memset(dst, 50, 12);
+    blendBytes(src, dst, 12, 0);
+    TEST_ASSERT_EQUAL(200, dst[0]);
+    TEST_ASSERT_EQUAL(200, dst[11]);
+    memset(dst, 50, 12);
+    blendBytes(src, dst, 12, 256);
+    TEST_ASSERT_EQUAL(50, dst[0]);
+    TEST_ASSERT_EQUAL(50, dst[11]);
+}
+
+void test_lerp_word_lanes() {
+    // Full scale in every byte, where a carry would spill into a neighbour
+    TEST_ASSERT_EQUAL_UINT32(0xffffffff, lerpWord(0xffffffff, 0xffffffff, 0));
+    TEST_ASSERT_EQUAL_UINT32(0xff00ff00, lerpWord(0xff00ff00, 0x00ff00ff, 0));
+    TEST_ASSERT_EQUAL_UINT32(0x7f7f7f7f, lerpWord(0xffffffff, 0, 128));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_scalar);
+    RUN_TEST(test_mismatched_alignment);
+    RUN_TEST(test_ends);
+    RUN_TEST(test_lerp_word_lanes);
+    return UNITY_END();
+}
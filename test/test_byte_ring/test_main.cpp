@@ -0,0 +1,102 @@
+// ByteRing, drained by a sink which takes only some of what's waiting, as
+// Serial does when its transmit buffer is nearly full
+#include "byte_ring.hpp"
+#include <stdlib.h>
+#include <string>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Take up to max bytes from the ring, as sendSerial() does
+template <uint32_t N> std::string drain(ByteRing<N> &ring, size_t max) {
+    std::string out;
+    while (max && ring.size()) {
+        size_t n;
+        const char *run = ring.peek(n, max);
+        out.append(run, n);
+        ring.consume(n);
+        max -= n;
+    }
+    return out;
+}
+
+// A record either fits whole or is dropped whole
+void test_all_or_nothing() {
+    ByteRing<16> ring;
+    ring.start();
+    ring.append("0123456789");
+    TEST_ASSERT_TRUE(ring.commit());
+    ring.start();
+    ring.append("abcd");
+    ring.append("efgh"); // 18 bytes in all, more than fit
+    TEST_ASSERT_FALSE(ring.commit());
+    TEST_ASSERT_EQUAL(1, ring.drops);
+    TEST_ASSERT_EQUAL(10, ring.size());
+    ring.start();
+    ring.append("xyz");
+    TEST_ASSERT_TRUE(ring.commit());
+    TEST_ASSERT_EQUAL_STRING("0123456789xyz", drain(ring, 100).c_str());
+}
+
+// Runs stop at the end of the buffer, so a record which wraps comes out in
+// two pieces, and nothing uncommitted is ever visible
+void test_wrap() {
+    ByteRing<16> ring;
+    ring.start();
+    ring.append("0123456789ab");
+    ring.commit();
+    TEST_ASSERT_EQUAL_STRING("0123456789", drain(ring, 10).c_str());
+    ring.start();
+    ring.append("cdefghij"); // wraps
+    ring.commit();
+    ring.start();
+    ring.append("pending");
+    size_t n;
+    ring.peek(n, 100);
+    TEST_ASSERT_EQUAL(6, n); // up to the end of the buffer
+    TEST_ASSERT_EQUAL_STRING("abcdefghij", drain(ring, 100).c_str());
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+// Random records into a ring drained a random amount at a time. What comes
+// out must be exactly the committed records, in order, and the drops must
+// be exactly those which didn't fit when they were written.
+void test_lossy_sink() {
+    srand(1);
+    ByteRing<256> ring;
+    std::string expected, out;
+    size_t waiting = 0; // bytes in the ring, by the model
+    uint32_t drops = 0;
+    for (int i = 0; i < 100000; i++) {
+        std::string record = std::to_string(i) + ":";
+        record.append(rand() % 60, 'a' + i % 26);
+        record += "\n";
+        ring.start();
+        const size_t split = rand() % record.size();
+        ring.append(record.data(), split);
+        ring.append(record.data() + split, record.size() - split);
+        const bool fits = waiting + record.size() <= 256;
+        TEST_ASSERT_EQUAL(fits, ring.commit());
+        if (fits)
+            expected += record, waiting += record.size();
+        else
+            drops++;
+
+        const std::string sent = drain(ring, rand() % 80);
+        out += sent;
+        waiting -= sent.size();
+    }
+    out += drain(ring, 256);
+    TEST_ASSERT_EQUAL(drops, ring.drops);
+    TEST_ASSERT_TRUE(drops > 0);
+    TEST_ASSERT_TRUE(expected == out);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_all_or_nothing);
+    RUN_TEST(test_wrap);
+    RUN_TEST(test_lossy_sink);
+    return UNITY_END();
+}
@@ -0,0 +1,119 @@
+// Logbook, writing to a partition emulated in host memory, which tools/host
+// counts erases of
+#include "logbook.hpp"
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+void setUp() {}
+void tearDown() {}
+
+esp_partition_t partition = {16 * LOGBOOK_SECTOR};
+
+// Whether any byte of flash has been written since it was erased
+bool flashWritten() {
+    for (uint8_t byte : hostFlash)
+        if (0xff != byte)
+            return true;
+    return false;
+}
+
+// The sequence number of the newest record on page 0, the last line
+unsigned long newest(Logbook &book) {
+    const std::string text = book.page(0).c_str();
+    const size_t last = text.rfind('\n', text.size() - 2);
+    return strtoul(text.c_str() + (last == text.npos ? 0 : last + 1), nullptr,
+                   10);
+}
+
+void drain(Logbook &book) {
+    book.drain([](const LogRecord &) {});
+}
+
+// Records wait in RAM, where /logs still shows them, until a batch is due
+void test_batches() {
+    static Logbook book;
+    book.begin();
+    LogSite site;
+    for (int i = 0; i < 3; i++) {
+        hostMillis += 1000;
+        book.write(site, logInfo, "info %d", i);
+        drain(book);
+    }
+    TEST_ASSERT_FALSE(flashWritten());
+    TEST_ASSERT_EQUAL(3, newest(book));
+
+    // A full batch is written at once
+    for (int i = 3; i < LOGBOOK_FLUSH_RECORDS; i++) {
+        hostMillis += 1000;
+        book.write(site, logInfo, "info %d", i);
+        drain(book);
+    }
+    TEST_ASSERT_TRUE(flashWritten());
+    TEST_ASSERT_EQUAL(1, hostErases);
+
+    // As is an error, and anything which has waited a minute
+    hostMillis += 1000;
+    book.write(site, logError, "error");
+    drain(book);
+    static Logbook reboot;
+    reboot.begin();
+    TEST_ASSERT_EQUAL(LOGBOOK_FLUSH_RECORDS + 1, newest(reboot));
+
+    hostMillis += 1000;
+    book.write(site, logInfo, "late");
+    drain(book);
+    hostMillis += LOGBOOK_FLUSH_MS;
+    drain(book);
+    static Logbook again;
+    again.begin();
+    TEST_ASSERT_EQUAL(LOGBOOK_FLUSH_RECORDS + 2, newest(again));
+    TEST_ASSERT_NOT_NULL(strstr(again.page(0).c_str(), "late"));
+}
+
+// Anything in flash which isn't a whole record is ignored on boot, however
+// large a sequence number it appears to have
+void test_garbage() {
+    const size_t record = sizeof(LogRecord);
+    static Logbook book;
+    book.begin();
+    const uint32_t last = newest(book);
+    memset(&hostFlash[8 * LOGBOOK_SECTOR], 0x7f, record);
+    memset(&hostFlash[8 * LOGBOOK_SECTOR + record], 0, record);
+    static Logbook garbage;
+    garbage.begin();
+    TEST_ASSERT_EQUAL(last, newest(garbage));
+
+    // A record torn by a reset is ignored too
+    hostFlash[(last - 1) * record + offsetof(LogRecord, text)] ^= 0x10;
+    static Logbook torn;
+    torn.begin();
+    TEST_ASSERT_EQUAL(last - 1, newest(torn));
+}
+
+// Threads sharing a call site never lose count of what was let through and
+// what was suppressed, though a race may let an extra record through
+void test_shared_site() {
+    static LogSite site;
+    std::atomic<uint32_t> allowed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            for (int i = 0; i < 100000; i++)
+                allowed += site.allow(5000);
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+    TEST_ASSERT_EQUAL(400000, allowed + site.suppressed);
+    TEST_ASSERT_TRUE(allowed >= LOGBOOK_BURST);
+    TEST_ASSERT_TRUE(allowed <= LOGBOOK_BURST + 4);
+}
+
+int main() {
+    hostPartition = &partition;
+    UNITY_BEGIN();
+    RUN_TEST(test_batches);
+    RUN_TEST(test_garbage);
+    RUN_TEST(test_shared_site);
+    return UNITY_END();
+}
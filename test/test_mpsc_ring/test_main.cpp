@@ -0,0 +1,79 @@
+// MpscRing, alone and with several producer threads against one consumer
+#include "mpsc_ring.hpp"
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+void setUp() {}
+void tearDown() {}
+
+// Fills to capacity, refuses one more, and empties in order, across the wrap
+void test_full_and_empty() {
+    MpscRing<uint32_t, 8> ring;
+    uint32_t value;
+    TEST_ASSERT_FALSE(ring.pop(value));
+    for (uint32_t round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < 8; i++)
+            TEST_ASSERT_TRUE(ring.push(round * 8 + i));
+        TEST_ASSERT_FALSE(ring.push(uint32_t(99)));
+        for (uint32_t i = 0; i < 8; i++) {
+            TEST_ASSERT_TRUE(ring.pop(value));
+            TEST_ASSERT_EQUAL(round * 8 + i, value);
+        }
+        TEST_ASSERT_FALSE(ring.pop(value));
+    }
+}
+
+// The consumer must see each producer's values complete and in order. A
+// producer retries when the ring is full, so nothing is lost.
+void test_producers() {
+    struct Item {
+        uint32_t producer, sequence, check;
+    };
+    const uint32_t producers = 4, count = 100000;
+    static MpscRing<Item, 64> ring;
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++)
+        threads.emplace_back([p] {
+            for (uint32_t i = 0; i < count; i++)
+                while (!ring.push([&](Item &item) {
+                    item.producer = p, item.sequence = i;
+                    item.check = p * 7919 + i;
+                }))
+                    std::this_thread::yield();
+        });
+
+    std::vector<uint32_t> next(producers, 0);
+    uint32_t received = 0, torn = 0, outOfOrder = 0;
+    Item item;
+    while (received < producers * count) {
+        if (!ring.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        received++;
+        if (item.producer >= producers ||
+            item.check != item.producer * 7919 + item.sequence) {
+            torn++;
+            continue;
+        }
+        outOfOrder += item.sequence != next[item.producer];
+        next[item.producer] = item.sequence + 1;
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    for (uint32_t p = 0; p < producers; p++)
+        TEST_ASSERT_EQUAL(count, next[p]);
+    TEST_ASSERT_FALSE(ring.pop(item));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_and_empty);
+    RUN_TEST(test_producers);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// The output planner: how panels are split between pins, and the show()
+// time predicted for them
+#include "outputs.hpp"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Every LED is driven by exactly one pin, in order, in whole panels
+void checkCovers(const OutputPlan &plan, const uint16_t *panelLeds,
+                 uint16_t numPanels) {
+    uint32_t offset = 0, panel = 0;
+    for (uint8_t i = 0; i < plan.numStrips; i++) {
+        TEST_ASSERT_EQUAL(offset, plan.strips[i].offset);
+        uint32_t count = 0;
+        while (count < plan.strips[i].count && panel < numPanels)
+            count += panelLeds[panel++];
+        TEST_ASSERT_EQUAL(plan.strips[i].count, count);
+        offset += count;
+    }
+    TEST_ASSERT_EQUAL(numPanels, panel);
+}
+
+void test_even_split() {
+    const OutputPlan plan = planOutputs(4, 256, 4);
+    TEST_ASSERT_EQUAL(4, plan.numStrips);
+    TEST_ASSERT_EQUAL(256, plan.longest);
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i * 256, plan.strips[i].offset);
+        TEST_ASSERT_EQUAL(256, plan.strips[i].count);
+    }
+}
+
+void test_more_pins_than_panels() {
+    const OutputPlan plan = planOutputs(3, 256, 4);
+    TEST_ASSERT_EQUAL(3, plan.numStrips);
+    TEST_ASSERT_EQUAL(0, plan.strips[3].count);
+    TEST_ASSERT_EQUAL(256, plan.longest);
+}
+
+void test_uneven_panels() {
+    // Best is {300}, {100, 100, 100}, {200}: longest 300
+    const uint16_t panels[] = {300, 100, 100, 100, 200};
+    const OutputPlan plan = planOutputs(panels, 5, 3);
+    TEST_ASSERT_EQUAL(300, plan.longest);
+    TEST_ASSERT_TRUE(plan.numStrips <= 3);
+    checkCovers(plan, panels, 5);
+}
+
+void test_degenerate() {
+    const uint16_t panels[] = {256};
+    TEST_ASSERT_EQUAL(0, planOutputs(panels, 0, 4).numStrips);
+    TEST_ASSERT_EQUAL(0, planOutputs(panels, 1, 0).numStrips);
+    TEST_ASSERT_EQUAL(0, planOutputs(uint16_t(0), 256, 4).numStrips);
+    // More pins than the planner knows are capped
+    TEST_ASSERT_EQUAL(OUTPUT_MAX_STRIPS, planOutputs(24, 16, 12).numStrips);
+}
+
+// Identical panels give the same plan either way, for every split
+void test_identical_panels_match_general_plan() {
+    uint16_t panels[64];
+    for (uint16_t numPanels = 1; numPanels <= 64; numPanels++)
+        for (uint8_t pins = 1; pins <= OUTPUT_MAX_STRIPS; pins++) {
+            for (uint16_t i = 0; i < numPanels; i++)
+                panels[i] = 64;
+            const OutputPlan a = planOutputs(numPanels, 64, pins);
+            const OutputPlan b = planOutputs(panels, numPanels, pins);
+            TEST_ASSERT_EQUAL(b.numStrips, a.numStrips);
+            TEST_ASSERT_EQUAL(b.longest, a.longest);
+            for (uint8_t i = 0; i < a.numStrips; i++) {
+                TEST_ASSERT_EQUAL(b.strips[i].offset, a.strips[i].offset);
+                TEST_ASSERT_EQUAL(b.strips[i].count, a.strips[i].count);
+            }
+            checkCovers(a, panels, numPanels);
+        }
+}
+
+void test_show_time() {
+    // 1.25us a bit, 30us an LED: 256 LEDs take 7680us, plus the latch
+    WS2812Timing timing;
+    timing.t1Ns = 250, timing.t2Ns = 625, timing.t3Ns = 375;
+    timing.overclock = 1;
+    TEST_ASSERT_FLOAT_WITHIN(.01f, 1250, timing.bitNs());
+    TEST_ASSERT_FLOAT_WITHIN(.1f, 7680 + 280, timing.stripUs(256));
+    TEST_ASSERT_FLOAT_WITHIN(.1f, 7960, planOutputs(4, 256, 4, timing).showUs);
+
+    // Four times the LEDs on one pin take four times as long to send
+    TEST_ASSERT_FLOAT_WITHIN(.1f, 4 * 7680 + 280,
+                             planOutputs(4, 256, 1, timing).showUs);
+
+    // Overclocking shortens the bits, but not the latch
+    timing.overclock = 1.25f;
+    TEST_ASSERT_FLOAT_WITHIN(.1f, 7680 / 1.25f + 280, timing.stripUs(256));
+}
+
+// Measured times, as loop() would see them, against the prediction
+void test_check_show() {
+    WS2812Timing timing;
+    timing.overclock = 1;
+    const OutputPlan plan = planOutputs(4, 256, 4, timing); // 7960us
+    // Drawing is quick, so show() waits for the last frame to be sent
+    TEST_ASSERT_EQUAL(showAsPlanned, checkShow(plan, 7000, 8200));
+    // Drawing is slow, so show() hardly waits
+    TEST_ASSERT_EQUAL(showAsPlanned, checkShow(plan, 300, 20000));
+    // The pins were driven one after the other
+    TEST_ASSERT_EQUAL(showSlower, checkShow(plan, 4 * 7680, 4 * 7960));
+    // Frames came faster than the LEDs could be sent them
+    TEST_ASSERT_EQUAL(showFaster, checkShow(plan, 3000, 4000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_even_split);
+    RUN_TEST(test_more_pins_than_panels);
+    RUN_TEST(test_uneven_panels);
+    RUN_TEST(test_degenerate);
+    RUN_TEST(test_identical_panels_match_general_plan);
+    RUN_TEST(test_show_time);
+    RUN_TEST(test_check_show);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+// RadarFrame encoding and RadarSequence, with frames reordered, repeated and
+// lost, as UDP may deliver them
+#include "radar_frame.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+RadarFrame makeFrame(uint32_t sequence, uint8_t count) {
+    RadarFrame frame;
+    frame.sequence = sequence;
+    frame.sensorMs = sequence * 100;
+    frame.count = count;
+    for (int i = 0; i < count; i++)
+        frame.targets[i] = {uint8_t(i), 1, int16_t(-100 * i), 2000, 30, 360};
+    return frame;
+}
+
+void test_decode() {
+    const RadarFrame frame = makeFrame(7, 2);
+    RadarFrame out;
+    TEST_ASSERT_TRUE(radarFrameDecode(&frame, radarFrameBytes(2), out));
+    TEST_ASSERT_EQUAL(7, out.sequence);
+    TEST_ASSERT_EQUAL(2, out.count);
+    TEST_ASSERT_EQUAL(-100, out.targets[1].x);
+    TEST_ASSERT_FALSE(radarFrameDecode(&frame, radarFrameBytes(1), out));
+    TEST_ASSERT_FALSE(radarFrameDecode(&frame, radarFrameBytes(0) - 1, out));
+
+    RadarFrame bad = frame;
+    bad.version++;
+    TEST_ASSERT_FALSE(radarFrameDecode(&bad, radarFrameBytes(2), out));
+}
+
+// 1 2 4 3 5 5 2: one lost then found, one duplicate, one late duplicate
+void test_reorder() {
+    RadarSequence sequence;
+    TEST_ASSERT_TRUE(sequence.accept(1));
+    TEST_ASSERT_TRUE(sequence.accept(2));
+    TEST_ASSERT_TRUE(sequence.accept(4));
+    TEST_ASSERT_EQUAL(1, sequence.lost);
+    TEST_ASSERT_FALSE(sequence.accept(3));
+    TEST_ASSERT_EQUAL(0, sequence.lost);
+    TEST_ASSERT_EQUAL(1, sequence.late);
+    TEST_ASSERT_TRUE(sequence.accept(5));
+    TEST_ASSERT_FALSE(sequence.accept(5));
+    TEST_ASSERT_FALSE(sequence.accept(2));
+    TEST_ASSERT_EQUAL(2, sequence.duplicate);
+    TEST_ASSERT_EQUAL(4, sequence.received);
+    TEST_ASSERT_EQUAL(0, sequence.lost);
+}
+
+// Frames from before the first, or before a restart, were never counted as
+// lost, so arriving late mustn't uncount them
+void test_late_before_counting() {
+    RadarSequence sequence;
+    TEST_ASSERT_TRUE(sequence.accept(10));
+    TEST_ASSERT_FALSE(sequence.accept(9));
+    TEST_ASSERT_FALSE(sequence.accept(8));
+    TEST_ASSERT_EQUAL(0, sequence.lost);
+    TEST_ASSERT_EQUAL(2, sequence.late);
+
+    TEST_ASSERT_TRUE(sequence.accept(12));
+    TEST_ASSERT_EQUAL(1, sequence.lost);
+    TEST_ASSERT_TRUE(sequence.accept(5000)); // the sender restarted
+    TEST_ASSERT_EQUAL(1, sequence.restarts);
+    TEST_ASSERT_FALSE(sequence.accept(4999));
+    TEST_ASSERT_EQUAL(1, sequence.lost);
+}
+
+// Frames lost beyond the 32 tracked stay lost, even if they turn up
+void test_long_gap() {
+    RadarSequence sequence;
+    TEST_ASSERT_TRUE(sequence.accept(1));
+    TEST_ASSERT_TRUE(sequence.accept(101));
+    TEST_ASSERT_EQUAL(99, sequence.lost);
+    TEST_ASSERT_FALSE(sequence.accept(100));
+    TEST_ASSERT_FALSE(sequence.accept(50));
+    TEST_ASSERT_EQUAL(98, sequence.lost);
+    TEST_ASSERT_FALSE(sequence.accept(100));
+    TEST_ASSERT_EQUAL(1, sequence.duplicate);
+}
+
+// Send frames over loopback out of order and with repeats, and check the
+// receiver's counts match what was sent
+void test_loopback() {
+    const int rx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const int tx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_TRUE(rx >= 0 && tx >= 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(rx, (sockaddr *)&addr, sizeof(addr)));
+    socklen_t addrLen = sizeof(addr);
+    getsockname(rx, (sockaddr *)&addr, &addrLen);
+
+    // Each group of 10 sent as 1 2 4 3 5 6 6 8 9 10, so one in ten is lost,
+    // one late and one repeated
+    const int order[10] = {1, 2, 4, 3, 5, 6, 6, 8, 9, 10};
+    int sent = 0;
+    for (int group = 0; group < 20; group++)
+        for (int i = 0; i < 10; i++, sent++) {
+            const RadarFrame frame = makeFrame(group * 10 + order[i], 3);
+            sendto(tx, &frame, radarFrameBytes(frame.count), 0,
+                   (sockaddr *)&addr, sizeof(addr));
+        }
+
+    RadarSequence sequence;
+    uint8_t buffer[sizeof(RadarFrame) + 1];
+    RadarFrame frame;
+    for (int i = 0; i < sent; i++) {
+        const int len = recv(rx, buffer, sizeof(buffer), 0);
+        TEST_ASSERT_TRUE(radarFrameDecode(buffer, len, frame));
+        sequence.accept(frame.sequence);
+    }
+    close(rx), close(tx);
+
+    TEST_ASSERT_EQUAL(160, sequence.received);
+    TEST_ASSERT_EQUAL(20, sequence.late);
+    TEST_ASSERT_EQUAL(20, sequence.duplicate);
+    TEST_ASSERT_EQUAL(20, sequence.lost);
+    TEST_ASSERT_EQUAL(0, sequence.restarts);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_decode);
+    RUN_TEST(test_reorder);
+    RUN_TEST(test_late_before_counting);
+    RUN_TEST(test_long_gap);
+    RUN_TEST(test_loopback);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+// Resolver, with its lookups answered by a stub rather than DNS, which can
+// fail, change its answers, or block as a dead DNS server would
+#include "resolver.hpp"
+#include <atomic>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+std::atomic<int> lookups{0};      // calls to the stub
+std::atomic<bool> blocked{false}; // the stub waits while this is set
+std::atomic<uint32_t> answer{1};  // the last byte of the address it gives
+
+// Names starting "bad" fail, and the rest resolve to 10.0.0.answer
+bool stubLookup(const char *host, in_addr &address) {
+    while (blocked)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    lookups++;
+    if (!strncmp(host, "bad", 3))
+        return false;
+    address.s_addr = htonl(0x0a000000 | answer);
+    return true;
+}
+
+// Wait up to a second of real time for the resolver's task
+template <typename Done> bool waitFor(Done done) {
+    for (int i = 0; i < 1000 && !done(); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return done();
+}
+
+uint32_t lastByte(const in_addr &address) {
+    return ntohl(address.s_addr) & 0xff;
+}
+
+void test_resolve_and_cache() {
+    in_addr address = {};
+    TEST_ASSERT_FALSE(resolver.resolve("host.one", address)); // not yet
+    TEST_ASSERT_TRUE(
+        waitFor([&] { return resolver.resolve("host.one", address); }));
+    TEST_ASSERT_EQUAL(1, lastByte(address));
+
+    // Answered from the cache, without another lookup
+    const int before = lookups;
+    hostMillis += 1000;
+    TEST_ASSERT_TRUE(resolver.resolve("host.one", address));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TEST_ASSERT_EQUAL(before, lookups);
+}
+
+// Once the address expires, the old one is used until the new one arrives
+void test_expiry() {
+    in_addr address = {};
+    answer = 2;
+    hostMillis += resolver.ttlMs;
+    TEST_ASSERT_TRUE(resolver.resolve("host.one", address));
+    TEST_ASSERT_EQUAL(1, lastByte(address));
+    TEST_ASSERT_TRUE(waitFor([&] {
+        return resolver.resolve("host.one", address) && 2 == lastByte(address);
+    }));
+}
+
+// A failure is cached for negativeTtlMs, then tried again
+void test_failure() {
+    in_addr address = {};
+    const int before = lookups;
+    TEST_ASSERT_FALSE(resolver.resolve("bad.host", address));
+    TEST_ASSERT_TRUE(waitFor([&] { return lookups == before + 1; }));
+    for (int i = 0; i < 10; i++, hostMillis += 1000)
+        TEST_ASSERT_FALSE(resolver.resolve("bad.host", address));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TEST_ASSERT_EQUAL(before + 1, lookups);
+
+    hostMillis += resolver.negativeTtlMs;
+    TEST_ASSERT_FALSE(resolver.resolve("bad.host", address));
+    TEST_ASSERT_TRUE(waitFor([&] { return lookups == before + 2; }));
+}
+
+// While a lookup is stuck, resolve() still answers at once from the cache
+void test_never_blocks() {
+    in_addr address = {};
+    blocked = true;
+    hostMillis += resolver.ttlMs; // so host.one is looked up again
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(resolver.resolve("host.one", address));
+        TEST_ASSERT_FALSE(resolver.resolve("host.two", address));
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    TEST_ASSERT_TRUE(elapsed < std::chrono::milliseconds(50));
+    blocked = false;
+    TEST_ASSERT_TRUE(
+        waitFor([&] { return resolver.resolve("host.two", address); }));
+}
+
+// The name least recently asked for is forgotten to make room
+void test_eviction() {
+    in_addr address = {};
+    const char *hosts[] = {"e.0", "e.1", "e.2", "e.3"};
+    for (const char *host : hosts) {
+        hostMillis += 10;
+        resolver.resolve(host, address);
+        TEST_ASSERT_TRUE(
+            waitFor([&] { return resolver.resolve(host, address); }));
+    }
+    // host.one was used before any of these, so it's gone
+    hostMillis += 10;
+    TEST_ASSERT_FALSE(resolver.resolve("host.one", address));
+    TEST_ASSERT_TRUE(
+        waitFor([&] { return resolver.resolve("host.one", address); }));
+}
+
+int main() {
+    resolver.lookup = stubLookup;
+    resolver.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_resolve_and_cache);
+    RUN_TEST(test_expiry);
+    RUN_TEST(test_failure);
+    RUN_TEST(test_never_blocks);
+    RUN_TEST(test_eviction);
+    return UNITY_END();
+}
@@ -0,0 +1,79 @@
+// TripleBuffer under contention: a producer thread publishing as fast as it
+// can while the consumer swaps buffers in, as the radar task and loop() do
+#include "snapshot.hpp"
+#include <atomic>
+#include <thread>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Big enough that a torn copy would be caught part way through
+struct Value {
+    uint32_t sequence;
+    uint32_t words[63]; // each derived from sequence
+};
+
+uint32_t word(uint32_t sequence, int i) { return sequence * 2654435761u + i; }
+
+void test_single_thread() {
+    TripleBuffer<Value> buffer;
+    TEST_ASSERT_FALSE(buffer.update());
+    buffer.back().sequence = 1;
+    buffer.publish();
+    buffer.back().sequence = 2;
+    buffer.publish(); // replaces 1, which was never read
+    TEST_ASSERT_TRUE(buffer.update());
+    TEST_ASSERT_EQUAL(2, buffer.front().sequence);
+    TEST_ASSERT_FALSE(buffer.update());
+    TEST_ASSERT_EQUAL(2, buffer.front().sequence); // unchanged
+}
+
+// Every value the consumer sees is whole, and newer than the last
+void test_contention() {
+    const uint32_t publishes = 200000;
+    TripleBuffer<Value> buffer;
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        for (uint32_t sequence = 1; sequence <= publishes; sequence++) {
+            Value &v = buffer.back();
+            v.sequence = sequence;
+            for (int i = 0; i < 63; i++)
+                v.words[i] = word(sequence, i);
+            buffer.publish();
+        }
+        done = true;
+    });
+
+    uint32_t last = 0, received = 0, torn = 0, backwards = 0;
+    for (;;) {
+        const bool finished = done; // then take whatever is left
+        while (buffer.update()) {
+            const Value &v = buffer.front();
+            for (int i = 0; i < 63; i++)
+                if (v.words[i] != word(v.sequence, i)) {
+                    torn++;
+                    break;
+                }
+            if (v.sequence <= last)
+                backwards++;
+            last = v.sequence;
+            received++;
+        }
+        if (finished)
+            break;
+        std::this_thread::yield(); // let the producer run on one core
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, backwards);
+    TEST_ASSERT_EQUAL(publishes, last); // the newest is never lost
+    TEST_ASSERT_GREATER_THAN(1, received);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_thread);
+    RUN_TEST(test_contention);
+    return UNITY_END();
+}
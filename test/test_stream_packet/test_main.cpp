@@ -0,0 +1,299 @@
+// The DDP, E1.31 and Art-Net parsers against well formed, truncated and
+// unwanted datagrams, and StreamAssembler's sequencing, syncs and universes
+#include "stream_packet.hpp"
+#include <unity.h>
+#include <vector>
+
+uint32_t unparsed = 0; // datagrams deliver() couldn't parse
+
+void setUp() { unparsed = 0; }
+void tearDown() { TEST_ASSERT_EQUAL(0, unparsed); }
+
+typedef std::vector<uint8_t> Bytes;
+
+void put16(Bytes &b, size_t at, uint16_t v) {
+    b[at] = v >> 8, b[at + 1] = v;
+}
+void put32(Bytes &b, size_t at, uint32_t v) {
+    put16(b, at, v >> 16), put16(b, at + 2, v);
+}
+
+// Pixel bytes which say where they came from
+Bytes pixels(size_t n, uint8_t first = 0) {
+    Bytes data(n);
+    for (size_t i = 0; i < n; i++)
+        data[i] = first + i;
+    return data;
+}
+
+Bytes ddp(uint8_t flags, uint8_t sequence, uint32_t offset, const Bytes &data,
+          bool timecode = false) {
+    const size_t header = timecode ? 14 : 10;
+    Bytes b(header);
+    b[0] = 0x40 | flags | (timecode ? 0x10 : 0);
+    b[1] = sequence, b[2] = 0x0b, b[3] = 1;
+    put32(b, 4, offset);
+    put16(b, 8, data.size());
+    b.insert(b.end(), data.begin(), data.end());
+    return b;
+}
+
+Bytes e131(uint16_t universe, uint8_t sequence, const Bytes &data,
+           uint16_t syncUniverse = 0, uint8_t options = 0) {
+    static const char identifier[] = "ASC-E1.17";
+    Bytes b(126);
+    put16(b, 0, 0x0010);
+    memcpy(&b[4], identifier, sizeof(identifier));
+    put32(b, 18, 4);
+    put32(b, 40, 2);
+    put16(b, 109, syncUniverse);
+    b[111] = sequence, b[112] = options;
+    put16(b, 113, universe);
+    b[117] = 2, b[118] = 0xa1;
+    put16(b, 123, data.size() + 1); // with the start code
+    b.insert(b.end(), data.begin(), data.end());
+    return b;
+}
+
+Bytes e131Sync(uint16_t address, uint8_t sequence) {
+    Bytes b = e131(0, 0, {});
+    b.resize(49);
+    put32(b, 18, 8);
+    put32(b, 40, 1);
+    b[44] = sequence;
+    put16(b, 45, address);
+    return b;
+}
+
+Bytes artDmx(uint16_t universe, uint8_t sequence, const Bytes &data) {
+    Bytes b(18);
+    memcpy(&b[0], "Art-Net", 8);
+    b[8] = 0x00, b[9] = 0x50, b[11] = 14;
+    b[12] = sequence;
+    b[14] = universe, b[15] = universe >> 8;
+    put16(b, 16, data.size());
+    b.insert(b.end(), data.begin(), data.end());
+    return b;
+}
+
+Bytes artSync() {
+    Bytes b = artDmx(0, 0, {});
+    b.resize(14);
+    b[8] = 0x00, b[9] = 0x52;
+    return b;
+}
+
+typedef bool (*Parser)(const uint8_t *, size_t, StreamPacket &);
+
+// Every prefix of a datagram shorter than the whole is refused
+void assertTruncationsRefused(Parser parse, const Bytes &b) {
+    StreamPacket packet;
+    TEST_ASSERT_TRUE(parse(b.data(), b.size(), packet));
+    for (size_t n = 0; n < b.size(); n++)
+        TEST_ASSERT_FALSE(parse(b.data(), n, packet));
+}
+
+void test_truncated() {
+    assertTruncationsRefused(ddpParse, ddp(1, 1, 0, pixels(30)));
+    assertTruncationsRefused(ddpParse, ddp(1, 1, 0, pixels(30), true));
+    assertTruncationsRefused(e131Parse, e131(1, 1, pixels(30)));
+    assertTruncationsRefused(artnetParse, artDmx(0, 1, pixels(30)));
+
+    // Lengths claiming more than the datagram holds, or a universe holds
+    StreamPacket packet;
+    Bytes b = ddp(1, 1, 0, pixels(30));
+    put16(b, 8, 31);
+    TEST_ASSERT_FALSE(ddpParse(b.data(), b.size(), packet));
+    b = e131(1, 1, pixels(30));
+    put16(b, 123, 32);
+    TEST_ASSERT_FALSE(e131Parse(b.data(), b.size(), packet));
+    b = e131(1, 1, pixels(513));
+    TEST_ASSERT_FALSE(e131Parse(b.data(), b.size(), packet));
+    b = artDmx(0, 1, pixels(30));
+    put16(b, 16, 31);
+    TEST_ASSERT_FALSE(artnetParse(b.data(), b.size(), packet));
+    b = artDmx(0, 1, pixels(513));
+    TEST_ASSERT_FALSE(artnetParse(b.data(), b.size(), packet));
+}
+
+// A property count of 0 has no start code, so it can't be DMX data
+void test_e131_property_count_0() {
+    StreamPacket packet;
+    Bytes b = e131(1, 1, pixels(30));
+    put16(b, 123, 0);
+    TEST_ASSERT_FALSE(e131Parse(b.data(), b.size(), packet));
+    b = e131(1, 1, {});
+    TEST_ASSERT_TRUE(e131Parse(b.data(), b.size(), packet));
+    TEST_ASSERT_EQUAL(0, packet.length);
+
+    // Nor is preview data, or an alternate start code, wanted
+    b = e131(1, 1, pixels(3), 0, 0x80);
+    TEST_ASSERT_FALSE(e131Parse(b.data(), b.size(), packet));
+    b = e131(1, 1, pixels(3));
+    b[125] = 0xdd;
+    TEST_ASSERT_FALSE(e131Parse(b.data(), b.size(), packet));
+}
+
+// The timecode moves the data along. Queries and replies are refused.
+void test_ddp_flags() {
+    StreamPacket packet;
+    Bytes b = ddp(0, 3, 6, pixels(9, 100), true);
+    TEST_ASSERT_TRUE(ddpParse(b.data(), b.size(), packet));
+    TEST_ASSERT_FALSE(packet.push);
+    TEST_ASSERT_EQUAL(3, packet.sequence);
+    TEST_ASSERT_EQUAL(6, packet.offset);
+    TEST_ASSERT_EQUAL(9, packet.length);
+    TEST_ASSERT_EQUAL(100, packet.data[0]);
+    TEST_ASSERT_EQUAL_PTR(b.data() + 14, packet.data);
+
+    b = ddp(0x02, 1, 0, {}); // query
+    TEST_ASSERT_FALSE(ddpParse(b.data(), b.size(), packet));
+    b = ddp(0x04, 1, 0, pixels(3)); // reply
+    TEST_ASSERT_FALSE(ddpParse(b.data(), b.size(), packet));
+    b = ddp(1, 1, 0, pixels(3));
+    b[3] = 246; // the status destination, not the display
+    TEST_ASSERT_FALSE(ddpParse(b.data(), b.size(), packet));
+}
+
+// Parse a datagram of any protocol, and pass it to the assembler
+bool deliver(StreamAssembler &assembler, const Bytes &b, uint32_t ms = 0) {
+    StreamPacket packet;
+    const bool ok = 'A' == b[0] && 'r' == b[1]
+                        ? artnetParse(b.data(), b.size(), packet)
+                    : 0x10 == b[1] ? e131Parse(b.data(), b.size(), packet)
+                                   : ddpParse(b.data(), b.size(), packet);
+    unparsed += !ok;
+    return ok && assembler.receive(packet, ms);
+}
+
+// Without pushes, a DDP frame completes when the end of it arrives
+void test_ddp_without_push() {
+    uint8_t frame[60] = {};
+    StreamAssembler assembler(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(deliver(assembler, ddp(0, 0, 0, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(0, 0, 30, pixels(30, 30))));
+    TEST_ASSERT_EQUAL(59, frame[59]);
+
+    // Once the sender pushes, only a push completes a frame
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 0, 0, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(assembler, ddp(0, 0, 30, pixels(30))));
+    TEST_ASSERT_EQUAL(2, assembler.frames);
+}
+
+// With 4 byte universes, pixels straddle them, and the remap still puts
+// each byte of a pixel in the right place
+void test_straddling_pixel() {
+    const uint16_t remap[4] = {3, 2, 1, 0};
+    uint8_t frame[12] = {};
+    StreamAssembler assembler(frame, sizeof(frame), remap);
+    assembler.channels = 4;
+    TEST_ASSERT_EQUAL(3, assembler.universes());
+    TEST_ASSERT_FALSE(deliver(assembler, artDmx(0, 0, pixels(4, 0))));
+    TEST_ASSERT_FALSE(deliver(assembler, artDmx(1, 0, pixels(4, 4))));
+    TEST_ASSERT_TRUE(deliver(assembler, artDmx(2, 0, pixels(4, 8))));
+    const uint8_t expected[12] = {9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2};
+    TEST_ASSERT_EQUAL_MEMORY(expected, frame, 12);
+}
+
+// Late and repeated packets are refused, across each protocol's wrap, and a
+// gap counts as lost
+void test_sequences() {
+    uint8_t frame[30] = {};
+    StreamAssembler assembler(frame, sizeof(frame));
+
+    // DDP counts 1 to 15, and may repeat a number within a frame
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 14, 0, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 15, 0, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 15, 0, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 1, 0, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(assembler, ddp(1, 14, 0, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(assembler, ddp(1, 3, 0, pixels(30))));
+    TEST_ASSERT_EQUAL(1, assembler.late);
+    TEST_ASSERT_EQUAL(1, assembler.lost);
+
+    // Art-Net counts 1 to 255, per universe
+    StreamAssembler art(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(deliver(art, artDmx(0, 254, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(art, artDmx(0, 255, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(art, artDmx(0, 255, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(art, artDmx(0, 1, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(art, artDmx(0, 254, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(art, artDmx(0, 0, pixels(30)))); // unnumbered
+    TEST_ASSERT_EQUAL(2, art.late);
+    TEST_ASSERT_EQUAL(0, art.lost);
+
+    // E1.31 counts 0 to 255, and refuses up to 20 behind
+    StreamAssembler sacn(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(deliver(sacn, e131(1, 255, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(sacn, e131(1, 0, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(sacn, e131(1, 0, pixels(30))));
+    TEST_ASSERT_FALSE(deliver(sacn, e131(1, 237, pixels(30))));
+    TEST_ASSERT_TRUE(deliver(sacn, e131(1, 3, pixels(30))));
+    TEST_ASSERT_EQUAL(2, sacn.late);
+    TEST_ASSERT_EQUAL(2, sacn.lost);
+}
+
+// Data held for a sync address complete a frame only when that address's
+// sync arrives. ArtSync completes one too, until syncs stop for 4 seconds.
+void test_syncs() {
+    uint8_t frame[60] = {};
+    StreamAssembler sacn(frame, sizeof(frame));
+    sacn.channels = 30;
+    TEST_ASSERT_FALSE(deliver(sacn, e131(1, 1, pixels(30), 7)));
+    TEST_ASSERT_FALSE(deliver(sacn, e131(2, 1, pixels(30), 7)));
+    TEST_ASSERT_FALSE(deliver(sacn, e131Sync(8, 1)));
+    TEST_ASSERT_TRUE(deliver(sacn, e131Sync(7, 1)));
+    TEST_ASSERT_FALSE(deliver(sacn, e131Sync(7, 2))); // nothing new
+
+    StreamAssembler art(frame, sizeof(frame));
+    art.channels = 30;
+    TEST_ASSERT_FALSE(deliver(art, artSync(), 0));
+    TEST_ASSERT_FALSE(deliver(art, artDmx(0, 1, pixels(30)), 10));
+    TEST_ASSERT_FALSE(deliver(art, artDmx(1, 1, pixels(30)), 10));
+    TEST_ASSERT_TRUE(deliver(art, artSync(), 20));
+    TEST_ASSERT_FALSE(deliver(art, artDmx(0, 2, pixels(30)), 5000));
+    TEST_ASSERT_TRUE(deliver(art, artDmx(1, 2, pixels(30)), 5000));
+    TEST_ASSERT_EQUAL(2, art.frames);
+}
+
+// A terminated stream's last packet is parsed, but its data are ignored
+void test_terminated() {
+    uint8_t frame[3] = {};
+    StreamAssembler assembler(frame, sizeof(frame));
+    StreamPacket packet;
+    const Bytes b = e131(1, 1, pixels(3, 9), 0, 0x40);
+    TEST_ASSERT_TRUE(e131Parse(b.data(), b.size(), packet));
+    TEST_ASSERT_TRUE(packet.terminated);
+    TEST_ASSERT_FALSE(assembler.receive(packet, 0));
+    TEST_ASSERT_EQUAL(0, frame[0]);
+    TEST_ASSERT_EQUAL(0, assembler.packets);
+}
+
+// A frame of more universes than are followed still completes, when the
+// ones followed have arrived
+void test_too_many_universes() {
+    const size_t channels = 3, size = channels * (STREAM_MAX_UNIVERSES + 40);
+    uint8_t frame[size] = {};
+    StreamAssembler assembler(frame, size);
+    assembler.channels = channels;
+    TEST_ASSERT_EQUAL(STREAM_MAX_UNIVERSES, assembler.universes());
+    bool complete = false;
+    for (uint16_t u = 0; u < STREAM_MAX_UNIVERSES + 40; u++)
+        complete |= deliver(assembler, artDmx(u, 0, pixels(channels)));
+    TEST_ASSERT_TRUE(complete);
+    TEST_ASSERT_EQUAL(1, assembler.frames);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_e131_property_count_0);
+    RUN_TEST(test_ddp_flags);
+    RUN_TEST(test_ddp_without_push);
+    RUN_TEST(test_straddling_pixel);
+    RUN_TEST(test_sequences);
+    RUN_TEST(test_syncs);
+    RUN_TEST(test_terminated);
+    RUN_TEST(test_too_many_universes);
+    return UNITY_END();
+}
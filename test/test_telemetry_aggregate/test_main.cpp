@@ -0,0 +1,121 @@
+// Aggregated telemetry, read back from the history which each report adds to
+#define TELEMETRY_IN_LOOP // call send() from here, rather than from a task
+#include "telemetry.hpp"
+#include <stdlib.h>
+#include <unity.h>
+
+Telemetry telemetry;
+
+void setUp() {}
+void tearDown() {}
+
+struct Sample {
+    uint32_t ms;
+    float value;
+};
+
+// The samples of a series, oldest first, or none if there is no such series
+std::vector<Sample> series(const String &name) {
+    std::vector<uint8_t> blocks;
+    uint8_t decimals;
+    telemetry.copyHistory(name, blocks, decimals);
+    std::vector<Sample> samples;
+    TelemetryHistory::Reader reader(blocks.data(), blocks.size());
+    Sample sample;
+    while (reader.next(sample.ms, sample.value))
+        samples.push_back(sample);
+    return samples;
+}
+
+// Advance the clock and send, as the telemetry task would
+void tick(uint32_t ms) {
+    hostMillis += ms;
+    telemetry.send();
+}
+
+// Random windows of reals and integers give the same mean, min, max and
+// count as a reference computation, once per window
+void test_windows() {
+    const Telemetry::Handle real =
+        telemetry.add("real", {.minMs = 1000, .aggregate = true});
+    const Telemetry::Handle integer =
+        telemetry.add("integer", {.minMs = 1000, .aggregate = true});
+    struct Expected {
+        float mean, min, max;
+        uint32_t n;
+    };
+    std::vector<Expected> reals, integers;
+    srand(1);
+    tick(1000);
+    for (int window = 0; window < 100; window++) {
+        const uint32_t n = 1 + rand() % 20;
+        Expected r = {0, 1e9f, -1e9f, n}, i = {0, 1e9f, -1e9f, n};
+        for (uint32_t s = 0; s < n; s++) {
+            const float v = rand() % 10000 / 100.f - 50;
+            const int32_t w = rand() % 2001 - 1000;
+            telemetry.set(real, v);
+            telemetry.set(integer, w);
+            r.mean += v, r.min = fminf(r.min, v), r.max = fmaxf(r.max, v);
+            i.mean += w, i.min = fminf(i.min, w), i.max = fmaxf(i.max, w);
+        }
+        r.mean /= n, i.mean /= n;
+        reals.push_back(r), integers.push_back(i);
+        tick(1000);
+    }
+
+    const char *names[] = {"real", "integer"};
+    std::vector<Expected> *expected[] = {&reals, &integers};
+    for (int d = 0; d < 2; d++) {
+        const String name = names[d];
+        const auto mean = series(name), min = series(name + " min"),
+                   max = series(name + " max"), n = series(name + " n");
+        TEST_ASSERT_EQUAL(100, mean.size());
+        TEST_ASSERT_EQUAL(100, n.size());
+        for (size_t w = 0; w < 100; w++) {
+            const Expected &e = (*expected[d])[w];
+            TEST_ASSERT_FLOAT_WITHIN(0.01f, e.mean, mean[w].value);
+            TEST_ASSERT_EQUAL_FLOAT(e.min, min[w].value);
+            TEST_ASSERT_EQUAL_FLOAT(e.max, max[w].value);
+            TEST_ASSERT_EQUAL_FLOAT(e.n, n[w].value);
+            TEST_ASSERT_EQUAL(mean[w].ms, n[w].ms);
+        }
+    }
+}
+
+// Once samples stop, the last mean, min and max are sent again every maxMs,
+// with a count of 0, rather than left to go stale
+void test_idle_expiry() {
+    const Telemetry::Handle h = telemetry.add(
+        "idle", {.minMs = 1000, .maxMs = 5000, .aggregate = true});
+    telemetry.set(h, 7);
+    telemetry.set(h, 9);
+    tick(1000);
+    for (int i = 0; i < 120; i++)
+        tick(100);
+
+    const auto mean = series("idle"), max = series("idle max"),
+               n = series("idle n");
+    TEST_ASSERT_EQUAL(3, mean.size()); // at once, then after 5 and 10 s
+    TEST_ASSERT_EQUAL(5000, mean[1].ms - mean[0].ms);
+    TEST_ASSERT_EQUAL(5000, mean[2].ms - mean[1].ms);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(8, mean[i].value);
+        TEST_ASSERT_EQUAL_FLOAT(9, max[i].value);
+        TEST_ASSERT_EQUAL_FLOAT(i ? 0 : 2, n[i].value);
+    }
+
+    // A new sample starts a window again, sent at minMs
+    telemetry.set(h, 1);
+    tick(1000);
+    TEST_ASSERT_EQUAL(4, series("idle").size());
+    TEST_ASSERT_EQUAL_FLOAT(1, series("idle").back().value);
+}
+
+int main() {
+    flags.udpTelemetry = flags.serialTelemetry = false;
+    telemetry.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_windows);
+    RUN_TEST(test_idle_expiry);
+    return UNITY_END();
+}
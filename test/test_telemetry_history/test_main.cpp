@@ -0,0 +1,70 @@
+// TelemetryHistory, copied a block at a time while samples keep arriving, as
+// Telemetry::copyHistory() does with the lock released between blocks
+#include "telemetry_history.hpp"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+uint8_t arena[8 * HISTORY_BLOCK];
+
+// The times of the samples in a download, which must be in order
+std::vector<uint32_t> times(const std::vector<uint8_t> &out) {
+    std::vector<uint32_t> ms;
+    TelemetryHistory::Reader reader(out.data(), out.size());
+    uint32_t t;
+    float value;
+    while (reader.next(t, value))
+        ms.push_back(t);
+    return ms;
+}
+
+// Two series sharing the arena, with samples of noise to fill blocks fast
+uint32_t fill(TelemetryHistory &history, uint32_t ms, int samples) {
+    for (int i = 0; i < samples; i++, ms += 100) {
+        history.add(0, ms, float(rand() % 1000));
+        history.add(1, ms, float(rand() % 1000));
+    }
+    return ms;
+}
+
+// A whole copy and a block by block copy are the same
+void test_copy_next() {
+    TelemetryHistory history;
+    history.begin(arena, sizeof(arena));
+    fill(history, 0, 150);
+    std::vector<uint8_t> whole, blocks;
+    history.copy(0, whole);
+    uint32_t cursor = 0, n = 0;
+    while (history.copyNext(0, cursor, blocks))
+        n++;
+    TEST_ASSERT_EQUAL(history.blocksOf(0), n);
+    TEST_ASSERT_TRUE(n > 1);
+    TEST_ASSERT_TRUE(whole == blocks);
+    TEST_ASSERT_FALSE(history.copyNext(0, cursor, blocks));
+}
+
+// Blocks reused between calls are skipped, and the copy stays in time order
+void test_reused_between_blocks() {
+    TelemetryHistory history;
+    history.begin(arena, sizeof(arena));
+    uint32_t ms = fill(history, 0, 200);
+    std::vector<uint8_t> out;
+    uint32_t cursor = 0, copied = 0;
+    while (history.copyNext(0, cursor, out)) {
+        copied++;
+        ms = fill(history, ms, 40); // opens a few blocks
+    }
+    const std::vector<uint32_t> t = times(out);
+    TEST_ASSERT_TRUE(copied > 1);
+    TEST_ASSERT_TRUE(t.size() > 0);
+    for (size_t i = 1; i < t.size(); i++)
+        TEST_ASSERT_TRUE(t[i] > t[i - 1]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_copy_next);
+    RUN_TEST(test_reused_between_blocks);
+    return UNITY_END();
+}
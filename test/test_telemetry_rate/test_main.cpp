@@ -0,0 +1,104 @@
+// TelemetryRate against a link which drops what it can't carry, as lwIP fails
+// sendto() when it runs out of buffers
+#include "telemetry_rate.hpp"
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// With the link never failing, a full queue is sent at the rate and no
+// faster, beyond the first burst
+void test_paces() {
+    TelemetryRate rate;
+    rate.begin(10000);
+    uint32_t bytes = 0;
+    for (uint32_t ms = 0; ms <= 60000; ms += 10)
+        while (rate.allow(1000, ms))
+            rate.sent(1000, ms), bytes += 1000;
+    TEST_ASSERT_TRUE(bytes <= 10000 * 60 + 2048);
+    TEST_ASSERT_TRUE(bytes >= 10000 * 60 - 1000);
+    TEST_ASSERT_FLOAT_WITHIN(1000, 10000, rate.bytesPerSecond);
+    TEST_ASSERT_FLOAT_WITHIN(1, 10, rate.packetsPerSecond);
+    TEST_ASSERT_EQUAL_FLOAT(1, rate.stretch(2));
+}
+
+// A link which carries capacity bytes/s and holds up to buffer bytes
+struct Link {
+    float capacity, buffer, queued = 0;
+    uint32_t lastMs = 0;
+
+    bool send(size_t bytes, uint32_t ms) {
+        queued -= capacity * (ms - lastMs) / 1000.f;
+        if (queued < 0)
+            queued = 0;
+        lastMs = ms;
+        if (queued + bytes > buffer)
+            return false;
+        queued += bytes;
+        return true;
+    }
+};
+
+// Sending far more than the link carries, the rate is cut back towards the
+// link's capacity rather than failing continually, and low priority data are
+// slowed most
+void test_lossy_link() {
+    TelemetryRate rate;
+    rate.begin(50000);
+    Link link = {8000, 4096};
+    uint32_t sent = 0, failedSends = 0;
+    float minRate = rate.rate, maxStretch = 0;
+    for (uint32_t ms = 0; ms <= 120000; ms += 10) {
+        while (rate.allow(1000, ms)) {
+            if (!link.send(1000, ms)) {
+                rate.failed(ms), failedSends++;
+                break;
+            }
+            rate.sent(1000, ms);
+            if (ms >= 60000)
+                sent += 1000;
+        }
+        if (rate.rate < minRate)
+            minRate = rate.rate;
+        if (rate.stretch(2) > maxStretch)
+            maxStretch = rate.stretch(2);
+    }
+
+    // Over the last minute, most of the link is used, with few failures
+    TEST_ASSERT_TRUE(sent >= 8000 * 60 * 3 / 4);
+    TEST_ASSERT_TRUE(sent <= 8000 * 60 + 4096);
+    TEST_ASSERT_EQUAL(failedSends, rate.failures);
+    TEST_ASSERT_TRUE(failedSends < 120 * 2); // a couple a second at most
+    TEST_ASSERT_TRUE(minRate >= rate.minRate);
+    TEST_ASSERT_TRUE(minRate < 50000);
+    TEST_ASSERT_TRUE(maxStretch > 1);
+    TEST_ASSERT_TRUE(maxStretch <= 64);
+}
+
+// Rate cuts halve at most once per backoffMs, never go below minRate, and
+// recover once sends succeed again
+void test_backoff_and_recovery() {
+    TelemetryRate rate;
+    rate.begin(20000);
+    for (uint32_t ms = 1000; ms < 1100; ms += 10)
+        rate.failed(ms);
+    TEST_ASSERT_EQUAL_FLOAT(10000, rate.rate);
+    for (uint32_t ms = 1500; ms < 10000; ms += 500)
+        rate.failed(ms);
+    TEST_ASSERT_EQUAL_FLOAT(rate.minRate, rate.rate);
+    TEST_ASSERT_EQUAL_FLOAT(1, rate.stretch(0));
+    TEST_ASSERT_EQUAL_FLOAT(20, rate.stretch(1));
+    TEST_ASSERT_EQUAL_FLOAT(64, rate.stretch(2));
+
+    rate.allow(0, 20000); // 10 s without failures
+    TEST_ASSERT_EQUAL_FLOAT(20000, rate.rate);
+    TEST_ASSERT_EQUAL_FLOAT(1, rate.stretch(2));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_paces);
+    RUN_TEST(test_lossy_link);
+    RUN_TEST(test_backoff_and_recovery);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// Binary telemetry, written by TelemetryWriter and read back by
+// TelemetryReader, and sent by Telemetry over loopback to a decoder like
+// tools/teleplot_bridge's, through a queue which overflows
+#define TELEMETRY_IN_LOOP // call send() from here, rather than from a task
+#include "telemetry.hpp"
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <unity.h>
+
+Telemetry telemetry;
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip() {
+    uint8_t buffer[256];
+    TelemetryWriter writer(buffer, sizeof(buffer));
+    writer.begin(wireValues, 0x1234);
+    writer.integer(3, -5);
+    writer.integer(300, INT32_MIN);
+    writer.real(4, 1.5f);
+    writer.text(5, "hello", 5);
+
+    TelemetryReader reader(writer.data(), writer.size());
+    TEST_ASSERT_TRUE(reader.begin());
+    TEST_ASSERT_EQUAL(wireValues, reader.kind);
+    TEST_ASSERT_EQUAL_HEX16(0x1234, reader.session);
+    TEST_ASSERT_EQUAL(3 << 2 | wireInteger, reader.varint());
+    TEST_ASSERT_EQUAL(-5, reader.zigzag());
+    TEST_ASSERT_EQUAL(300 << 2 | wireInteger, reader.varint());
+    TEST_ASSERT_EQUAL(INT32_MIN, reader.zigzag());
+    TEST_ASSERT_EQUAL(4 << 2 | wireReal, reader.varint());
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, reader.real());
+    TEST_ASSERT_EQUAL(5 << 2 | wireText, reader.varint());
+    size_t n;
+    const char *text = reader.string(n);
+    TEST_ASSERT_EQUAL(5, n);
+    TEST_ASSERT_EQUAL_MEMORY("hello", text, 5);
+    TEST_ASSERT_FALSE(reader.more());
+    TEST_ASSERT_TRUE(reader.ok);
+}
+
+void test_dictionary_round_trip() {
+    uint8_t buffer[256];
+    TelemetryWriter writer(buffer, sizeof(buffer));
+    writer.begin(wireDictionary, 7);
+    writer.dictionary(200, 3, "fps", 3, "Hz", 2, "", 0);
+
+    TelemetryReader reader(writer.data(), writer.size());
+    TEST_ASSERT_TRUE(reader.begin());
+    TEST_ASSERT_EQUAL(wireDictionary, reader.kind);
+    TEST_ASSERT_EQUAL(200, reader.varint());
+    TEST_ASSERT_EQUAL(3, reader.byte());
+    size_t n;
+    TEST_ASSERT_EQUAL_MEMORY("fps", reader.string(n), 3);
+    TEST_ASSERT_EQUAL_MEMORY("Hz", reader.string(n), 2);
+    reader.string(n);
+    TEST_ASSERT_EQUAL(0, n);
+    TEST_ASSERT_TRUE(reader.ok);
+
+    // A packet cut short fails, rather than reading past its end
+    TelemetryReader cut(writer.data(), writer.size() - 2);
+    TEST_ASSERT_TRUE(cut.begin());
+    cut.varint(), cut.byte(), cut.string(n), cut.string(n);
+    TEST_ASSERT_FALSE(cut.ok);
+}
+
+// Decodes packets as tools/teleplot_bridge does
+struct Bridge {
+    std::map<uint32_t, std::string> dictionary;
+    uint32_t values = 0, unknown = 0;
+
+    void receive(const uint8_t *packet, size_t size) {
+        TelemetryReader reader(packet, size);
+        TEST_ASSERT_TRUE(reader.begin());
+        size_t n;
+        while (reader.more()) {
+            if (wireDictionary == reader.kind) {
+                const uint32_t handle = reader.varint();
+                reader.byte();
+                const char *name = reader.string(n);
+                dictionary[handle] = std::string(name, n);
+                reader.string(n), reader.string(n);
+                continue;
+            }
+            const uint32_t key = reader.varint();
+            if (wireInteger == (key & 3))
+                reader.zigzag();
+            else if (wireReal == (key & 3))
+                reader.real();
+            else
+                reader.string(n);
+            if (dictionary.count(key >> 2))
+                values++;
+            else
+                unknown++;
+        }
+        TEST_ASSERT_TRUE(reader.ok);
+    }
+};
+
+// Send far more than the network allows, so the queue overflows and drops
+// the oldest entries, which include the descriptions of the data. The bridge
+// must never receive a value it can't decode.
+void test_queue_overflow() {
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    TEST_ASSERT_EQUAL(0, bind(sock, (sockaddr *)&address, length));
+    getsockname(sock, (sockaddr *)&address, &length);
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+
+    preferences.putString("telemetry_host", "127.0.0.1");
+    preferences.putUInt("telemetry_port", ntohs(address.sin_port));
+    preferences.putUInt("telemetry_bps", 100);
+    flags.udpTelemetry = flags.binaryTelemetry = flags.wifiConnected = true;
+    flags.serialTelemetry = false;
+    telemetry.begin();
+
+    std::vector<Telemetry::Handle> handles;
+    for (int i = 0; i < 60; i++)
+        handles.push_back(
+            telemetry.add("overflow " + String(i), {.minMs = 100}));
+
+    Bridge bridge;
+    uint8_t packet[2048];
+    for (int tick = 0; tick < 600; tick++) {
+        hostMillis += 100;
+        for (size_t i = 0; i < handles.size(); i++)
+            telemetry.set(handles[i], float(tick + i));
+        telemetry.send();
+        ssize_t n;
+        while ((n = recv(sock, packet, sizeof(packet), 0)) > 0)
+            bridge.receive(packet, n);
+    }
+    close(sock);
+
+    TEST_ASSERT_EQUAL(0, bridge.unknown);
+    TEST_ASSERT_TRUE(bridge.values > 0);
+    TEST_ASSERT_TRUE(bridge.dictionary.count(handles.back()));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_dictionary_round_trip);
+    RUN_TEST(test_queue_overflow);
+    return UNITY_END();
+}
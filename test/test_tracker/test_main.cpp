@@ -0,0 +1,124 @@
+// RadarTracker, driven by traces of detections like the LD2450's, at 10Hz
+#include "tracker.hpp"
+#include <stdlib.h>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Roughly uniform noise of up to +-mm, repeatable
+float noise(float mm) { return (rand() / float(RAND_MAX) * 2 - 1) * mm; }
+
+// A target walking at constant velocity, reported every 100ms with noise
+void test_constant_velocity() {
+    srand(1);
+    RadarTracker tracker;
+    const float vx = 800, vy = -300; // mm/s
+    for (uint32_t ms = 0; ms <= 5000; ms += 100) {
+        Detection d = {-2000 + vx * ms / 1000 + noise(30),
+                       3000 + vy * ms / 1000 + noise(30)};
+        tracker.update(ms, &d, 1);
+    }
+    const Track &track = tracker.tracks[0];
+    TEST_ASSERT_TRUE(track.active);
+    TEST_ASSERT_FLOAT_WITHIN(100, vx, track.vx);
+    TEST_ASSERT_FLOAT_WITHIN(100, vy, track.vy);
+    TEST_ASSERT_EQUAL(5000, track.movingMs);
+
+    // Between reports, the prediction carries on along the path
+    float x, y;
+    TEST_ASSERT_TRUE(tracker.predict(0, 5050, x, y));
+    TEST_ASSERT_FLOAT_WITHIN(60, -2000 + vx * 5.05f, x);
+    TEST_ASSERT_FLOAT_WITHIN(60, 3000 + vy * 5.05f, y);
+    TEST_ASSERT_FALSE(tracker.predict(1, 5050, x, y));
+}
+
+// Two reports in the same millisecond must not blow up the velocity
+void test_same_timestamp() {
+    RadarTracker tracker;
+    for (uint32_t ms = 0; ms <= 1000; ms += 100) {
+        Detection d = {float(ms), 1000};
+        tracker.update(ms, &d, 1);
+    }
+    const float vx = tracker.tracks[0].vx, x = tracker.tracks[0].x;
+    Detection d = {1000 + 40, 1000};
+    tracker.update(1000, &d, 1);
+    TEST_ASSERT_EQUAL(vx, tracker.tracks[0].vx);
+    TEST_ASSERT_FLOAT_WITHIN(.01f, x + tracker.alpha * (1040 - x),
+                             tracker.tracks[0].x);
+
+    // And one from before the last is treated the same way
+    tracker.update(990, &d, 1);
+    TEST_ASSERT_EQUAL(vx, tracker.tracks[0].vx);
+    TEST_ASSERT_EQUAL(1000, tracker.tracks[0].updateMs);
+}
+
+// After a gap, the update starts from the capped prediction, as predict()
+// gives it, so a report close to that is associated and barely corrects it
+void test_gap_uses_capped_prediction() {
+    RadarTracker tracker;
+    for (uint32_t ms = 0; ms <= 2000; ms += 100) {
+        Detection d = {float(ms), 0}; // 1000mm/s
+        tracker.update(ms, &d, 1);
+    }
+    float px, py;
+    tracker.predict(0, 3500, px, py);
+    TEST_ASSERT_FLOAT_WITHIN(20, 2000 + 500, px); // capped at 500ms
+    const float vx = tracker.tracks[0].vx;
+    Detection d = {px, py};
+    tracker.update(3500, &d, 1);
+    TEST_ASSERT_FLOAT_WITHIN(1, px, tracker.tracks[0].x);
+    TEST_ASSERT_FLOAT_WITHIN(1, vx, tracker.tracks[0].vx);
+}
+
+// Two targets crossing paths keep their own tracks
+void test_crossing_targets() {
+    srand(2);
+    RadarTracker tracker;
+    for (uint32_t ms = 0; ms <= 4000; ms += 100) {
+        const float t = ms / 1000.f;
+        Detection d[2] = {{-2000 + 1000 * t + noise(20), 2000 + noise(20)},
+                          {2000 - 1000 * t + noise(20), 2600 + noise(20)}};
+        tracker.update(ms, d, 2);
+    }
+    int right = -1, left = -1;
+    for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+        if (!tracker.tracks[i].active)
+            continue;
+        if (tracker.tracks[i].vx > 0)
+            right = i;
+        else
+            left = i;
+    }
+    TEST_ASSERT_TRUE(right >= 0 && left >= 0);
+    TEST_ASSERT_FLOAT_WITHIN(100, 2000, tracker.tracks[right].x);
+    TEST_ASSERT_FLOAT_WITHIN(100, 2000, tracker.tracks[right].y);
+    TEST_ASSERT_FLOAT_WITHIN(100, -2000, tracker.tracks[left].x);
+    TEST_ASSERT_FLOAT_WITHIN(100, 2600, tracker.tracks[left].y);
+}
+
+// A target which stops being reported is dropped, and a new one far from any
+// track starts its own
+void test_timeout_and_new_track() {
+    RadarTracker tracker;
+    Detection a = {0, 1000}, b = {3000, 3000};
+    tracker.update(0, &a, 1);
+    tracker.update(100, &b, 1);
+    TEST_ASSERT_TRUE(tracker.tracks[0].active);
+    TEST_ASSERT_TRUE(tracker.tracks[1].active);
+    TEST_ASSERT_EQUAL(0, tracker.tracks[1].vx);
+    for (uint32_t ms = 200; ms <= 2100; ms += 100)
+        tracker.update(ms, &b, 1);
+    TEST_ASSERT_FALSE(tracker.tracks[0].active);
+    TEST_ASSERT_TRUE(tracker.tracks[1].active);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_velocity);
+    RUN_TEST(test_same_timestamp);
+    RUN_TEST(test_gap_uses_capped_prediction);
+    RUN_TEST(test_crossing_targets);
+    RUN_TEST(test_timeout_and_new_track);
+    return UNITY_END();
+}
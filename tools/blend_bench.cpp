@@ -0,0 +1,79 @@
+// Benchmark Crossfader's blend on a PC: blendBytes() against a per-pixel
+// blend like FastLED's CRGB::blend(), and the snapshot Crossfader copies
+// when a crossfade starts. Every weight is first checked against the scalar
+// formula.
+//
+//   g++ -O2 -std=c++17 -I src tools/blend_bench.cpp -o blend_bench
+//   ./blend_bench
+//
+// The timings are the PC's, so compare them with each other rather than
+// with the ESP32's. On the ESP32, benchmarkEffects() times each pair of
+// effects crossfading both ways, as "FxEngine a>b" and "Crossfader a>b".
+
+#include "blend_bytes.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+const size_t numLeds = 32 * 32, frameSize = numLeds * 3;
+
+// FastLED's blend8(), which CRGB::blend() applies to each channel
+inline uint8_t blend8(uint8_t a, uint8_t b, uint8_t amountOfB) {
+    uint16_t partial = (a << 8) | b;
+    partial += b * amountOfB;
+    partial -= a * amountOfB;
+    return partial >> 8;
+}
+
+template <typename Blend> double nsPerFrame(Blend blend) {
+    const int iterations = 20000;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        blend(i & 255);
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main() {
+    std::vector<uint8_t> a(frameSize), b(frameSize), c(frameSize);
+    for (size_t i = 0; i < frameSize; i++)
+        a[i] = i * 7, b[i] = i * 13 + 5;
+
+    // Every weight gives exactly the scalar formula Crossfader documents
+    for (uint16_t f = 0; f <= 256; f++) {
+        c = b;
+        blendBytes(a.data(), c.data(), frameSize, f);
+        for (size_t i = 0; i < frameSize; i++)
+            if (c[i] != uint8_t((a[i] * (256 - f) + b[i] * f) >> 8)) {
+                printf("blendBytes differs at f %u byte %zu\n", f, i);
+                return 1;
+            }
+    }
+
+    volatile uint32_t sink = 0;
+    const double perPixel = nsPerFrame([&](uint8_t f) {
+        for (size_t i = 0; i < frameSize; i++)
+            b[i] = blend8(a[i], b[i], f);
+        sink = sink + b[f];
+    });
+    const double bytes = nsPerFrame([&](uint8_t f) {
+        blendBytes(a.data(), b.data(), frameSize, f);
+        sink = sink + b[f];
+    });
+    const double unaligned = nsPerFrame([&](uint8_t f) {
+        blendBytes(a.data() + 1, b.data() + 1, frameSize - 1, f);
+        sink = sink + b[f];
+    });
+    const double copy = nsPerFrame([&](uint8_t f) {
+        memcpy(c.data(), b.data(), frameSize);
+        sink = sink + c[f];
+    });
+    printf("%zu LEDs, ns/frame\n", numLeds);
+    printf("per pixel blend8  %8.0f\n", perPixel);
+    printf("blendBytes        %8.0f  %.1fx\n", bytes, perPixel / bytes);
+    printf("  unaligned       %8.0f\n", unaligned);
+    printf("snapshot memcpy   %8.0f\n", copy);
+    return 0;
+}
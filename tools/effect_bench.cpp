@@ -0,0 +1,41 @@
+/*
+
+Run benchmarkEffects() on Linux, so a change which slows an effect down is
+caught without a board: every Animartrix animation, both NoisePalettes, FxSui,
+and every crossfade between them, drawn on the sketch's real XYMap by FastLED
+built for its stub platform.
+
+    pio run -e bench -t exec
+
+It prints the same CSV as the Benchmark button on the index page, comparing
+each timing with the PC's table in benchmark_baseline.hpp, and exits with 1 if
+any benchmark regressed. The timings are the PC's, so only compare them with
+other runs on the same PC.
+
+*/
+
+// The matrix, as in main.cpp
+#define MATRIX_WIDTH 32
+#define MATRIX_HEIGHT 32
+#define NUM_LEDS (MATRIX_WIDTH * MATRIX_HEIGHT)
+#define PANEL_WIDTH 16
+#define PANEL_HEIGHT 16
+#define XY_CONFIG (xySerpentine | xyColumnMajor | xySerpentineTiling)
+#define FIRST_ANIMATION RGB_BLOBS5
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <fx/2d/animartrix.hpp>
+#include <fx/2d/noisepalette.h>
+#include <fx/fx_engine.h>
+
+#include "XY.hpp"
+#include "fxSui.hpp"
+#include "telemetry.hpp"
+Telemetry telemetry;
+
+#include "benchmark.hpp"
+
+CRGB leds[NUM_LEDS];
+
+int main() { return benchmarkEffects(leds) ? 1 : 0; }
@@ -0,0 +1,173 @@
+// Benchmark telemetry_history.hpp on a PC, or decode a binary download from
+// /history?name=...&format=bin into CSV.
+//
+//   g++ -O2 -std=c++17 -I src tools/history_bench.cpp -o history_bench
+//   ./history_bench
+//   ./history_bench fps.bin > fps.csv
+//
+// The benchmark feeds synthetic data shaped like the sketch's own through
+// the telemetry task's timing: the task wakes about every 100ms, coalesces
+// at most every 200ms, and sends a datum once its minMs has passed. It
+// prints the bytes per sample, the ratio to storing 4 byte times and values
+// raw, the cost of each add(), and how many hours the arena would hold.
+
+#include "telemetry_history.hpp"
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Print a download as ms,value lines
+int decode(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(file);
+
+    TelemetryHistory::Reader reader(data.data(), data.size());
+    uint32_t ms;
+    float value;
+    printf("ms,value\n");
+    while (reader.next(ms, value))
+        printf("%lu,%.9g\n", (unsigned long)ms, value);
+    return 0;
+}
+
+struct Series {
+    const char *name;
+    uint32_t minMs;
+    float (*value)(std::mt19937 &random, uint32_t ms);
+};
+
+// Each datum changes about the way the real one does
+Series series[] = {
+    {"fps", 1000,
+     [](std::mt19937 &r, uint32_t) {
+         return 60.f + std::normal_distribution<float>(0, 0.4f)(r);
+     }},
+    {"frame p99", 5000,
+     [](std::mt19937 &r, uint32_t) {
+         return (32 + int(std::uniform_int_distribution<>(0, 3)(r))) * 0.5f;
+     }},
+    {"render mean", 1000,
+     [](std::mt19937 &r, uint32_t) {
+         return 9.f + std::normal_distribution<float>(0, 0.6f)(r);
+     }},
+    {"render n", 1000,
+     [](std::mt19937 &r, uint32_t) {
+         return float(std::uniform_int_distribution<>(19, 21)(r));
+     }},
+    {"Heap Free", 10000,
+     [](std::mt19937 &r, uint32_t) {
+         return 180 + std::uniform_int_distribution<>(0, 16)(r) / 4.f;
+     }},
+    {"Telemetry drops", 600000, [](std::mt19937 &, uint32_t) { return 0.f; }},
+    {"UDP rate", 1000,
+     [](std::mt19937 &, uint32_t ms) {
+         return fminf(20000, 1000 + (ms % 60000) * 0.5f);
+     }},
+};
+const int seriesCount = sizeof(series) / sizeof(series[0]);
+
+// Check each series decodes to exactly the newest of the samples added
+bool verify(const TelemetryHistory &history, int s,
+            const std::vector<std::pair<uint32_t, float>> &expected,
+            size_t &count, size_t &bytes) {
+    std::vector<uint8_t> download;
+    history.copy(s, download);
+    bytes = download.size();
+    std::vector<std::pair<uint32_t, float>> decoded;
+    TelemetryHistory::Reader reader(download.data(), download.size());
+    uint32_t ms;
+    float value;
+    while (reader.next(ms, value))
+        decoded.push_back({ms, value});
+    count = decoded.size();
+    if (count > expected.size())
+        return false;
+    const size_t lost = expected.size() - count;
+    for (size_t i = 0; i < count; i++)
+        if (decoded[i].first != expected[lost + i].first ||
+            memcmp(&decoded[i].second, &expected[lost + i].second, 4))
+            return false;
+    return true;
+}
+
+int bench() {
+    // Simulate an hour of the telemetry task
+    std::mt19937 random(1);
+    std::vector<uint32_t> sentMs(seriesCount, 0);
+    std::vector<std::vector<std::pair<uint32_t, float>>> expected(seriesCount);
+    std::vector<std::pair<int, std::pair<uint32_t, float>>> samples;
+    uint32_t lastCoalesce = 0;
+    for (uint32_t now = 0; now < 3600000;
+         now += 100 + std::uniform_int_distribution<>(0, 2)(random)) {
+        if (now - lastCoalesce < 200)
+            continue;
+        lastCoalesce = now;
+        for (int s = 0; s < seriesCount; s++) {
+            if (now - sentMs[s] < series[s].minMs)
+                continue;
+            sentMs[s] = now;
+            const float value = series[s].value(random, now);
+            samples.push_back({s, {now, value}});
+            expected[s].push_back({now, value});
+        }
+    }
+
+    // A small arena first, to check the oldest blocks are overwritten
+    // cleanly, then one large enough to hold the hour
+    for (const size_t arenaSize : {16 * 1024, 2048 * 1024}) {
+        std::vector<uint8_t> arena(arenaSize);
+        TelemetryHistory history;
+        history.begin(arena.data(), arena.size());
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &sample : samples)
+            history.add(sample.first, sample.second.first,
+                        sample.second.second);
+        const double ns = std::chrono::duration<double, std::nano>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          samples.size();
+
+        printf("%zu KiB arena\n", arenaSize / 1024);
+        printf("%-16s %8s %10s %6s\n", "series", "samples", "bytes", "B/smp");
+        size_t kept = 0, keptBytes = 0;
+        for (int s = 0; s < seriesCount; s++) {
+            size_t count, bytes;
+            if (!verify(history, s, expected[s], count, bytes)) {
+                printf("%s decoded wrongly\n", series[s].name);
+                return 1;
+            }
+            kept += count, keptBytes += bytes;
+            printf("%-16s %8zu %10zu %6.2f\n", series[s].name, count, bytes,
+                   count ? double(bytes) / count : 0);
+        }
+
+        uint32_t used, stored;
+        history.usage(used, stored);
+        const double perSample = double(keptBytes) / kept;
+        const double blockBytes = double(used) * HISTORY_BLOCK / stored;
+        printf("%zu of %zu samples kept, %.2f bytes each (%.2f in whole "
+               "blocks), %.1fx smaller than raw\n",
+               kept, samples.size(), perSample, blockBytes, 8 / perSample);
+        printf("add() took %.0f ns\n", ns);
+        printf("The arena would hold %.1f hours of these %d series\n\n",
+               arenaSize / blockBytes / samples.size(), seriesCount);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1)
+        return decode(argv[1]);
+    return bench();
+}
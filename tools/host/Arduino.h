@@ -0,0 +1,174 @@
+#pragma once
+// Just enough of Arduino-ESP32 and FreeRTOS to build Telemetry and its
+// helpers on Linux, for the tools in tools/ and the tests in test/, which
+// put tools/host before src on the include path.
+//
+// millis() is a fake clock, which the tool advances by setting hostMillis,
+// so hours can pass in seconds. micros() is the real clock, so code which
+// times itself with micros() measures real CPU time. Tasks are threads,
+// mutexes are std::mutex, and sockets are real, via lwip/sockets.h.
+// Everything is defined here, as each tool is one translation unit.
+
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#if defined(FASTLED_STUB_IMPL)
+// Built with FastLED for its stub platform, as tools/effect_bench.cpp is.
+// FastLED then has millis(), micros() and delay(), on the real clock.
+#include <FastLED.h>
+#else
+uint32_t hostMillis = 0; // the fake clock
+
+inline uint32_t millis() { return hostMillis; }
+inline uint32_t micros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+inline void delay(uint32_t ms) { hostMillis += ms; }
+#endif
+inline uint32_t esp_random() { return rand(); }
+inline void *ps_malloc(size_t size) { return malloc(size); }
+
+// The parts of Arduino's String which the sketch uses
+class String {
+  public:
+    String() {}
+    String(const char *s) : s(s ? s : "") {}
+    String(const std::string &s) : s(s) {}
+    String(int i) : s(std::to_string(i)) {}
+    String(unsigned i) : s(std::to_string(i)) {}
+    String(long i) : s(std::to_string(i)) {}
+    String(unsigned long i) : s(std::to_string(i)) {}
+    String(double d, unsigned char decimals = 2) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", decimals, d);
+        s = text;
+    }
+
+    unsigned length() const { return s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    const char *c_str() const { return s.c_str(); }
+    char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+    long toInt() const { return atol(s.c_str()); }
+    String substring(unsigned from, unsigned to) const {
+        return s.substr(from, to - from);
+    }
+
+    bool concat(const char *p, unsigned n) {
+        s.append(p, n);
+        return true;
+    }
+    void replace(const char *from, const char *to) {
+        const size_t n = strlen(from), m = strlen(to);
+        for (size_t at = 0; (at = s.find(from, at)) != std::string::npos;
+             at += m)
+            s.replace(at, n, to);
+    }
+    String &operator+=(const String &o) { return s += o.s, *this; }
+    String &operator+=(const char *o) { return s += o, *this; }
+    String &operator+=(char c) { return s += c, *this; }
+    friend String operator+(const String &a, const String &b) {
+        return a.s + b.s;
+    }
+    friend String operator+(const String &a, const char *b) { return a.s + b; }
+    friend String operator+(const char *a, const String &b) { return a + b.s; }
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator==(const char *o) const { return s == o; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator<(const String &o) const { return s < o.s; }
+
+  private:
+    std::string s;
+};
+
+// Serial writes to stdout, and never runs out of room
+struct HostSerial {
+    int availableForWrite() { return 4096; }
+    size_t write(const uint8_t *p, size_t n) { return fwrite(p, 1, n, stdout); }
+    size_t print(const char *s) { return fputs(s, stdout); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t println(const char *s) { return printf("%s\n", s); }
+    size_t println(const String &s) { return println(s.c_str()); }
+    int printf(const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        const int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+} Serial;
+
+// Plausible numbers for an ESP32-S3 with 8 MiB of PSRAM
+struct HostESP {
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 150000; }
+    uint32_t getMaxAllocHeap() { return 100000; }
+    uint32_t getFreePsram() { return 6000000; }
+    uint32_t getMinFreePsram() { return 5000000; }
+    uint32_t getMaxAllocPsram() { return 4000000; }
+} ESP;
+
+// FreeRTOS tasks as detached threads, each with a notification count
+struct HostTask {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t count = 0;
+};
+typedef HostTask *TaskHandle_t;
+typedef std::mutex *SemaphoreHandle_t;
+thread_local TaskHandle_t hostCurrentTask = nullptr;
+
+#define portMAX_DELAY 0xffffffff
+#define pdTRUE 1
+#define pdMS_TO_TICKS(ms) (ms)
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+inline int xSemaphoreTake(SemaphoreHandle_t mutex, uint32_t) {
+    mutex->lock();
+    return pdTRUE;
+}
+inline int xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->unlock();
+    return pdTRUE;
+}
+
+inline int xTaskCreatePinnedToCore(void (*function)(void *), const char *,
+                                   uint32_t, void *param, int,
+                                   TaskHandle_t *handle, int) {
+    TaskHandle_t task = new HostTask;
+    if (handle)
+        *handle = task;
+    std::thread([=] {
+        hostCurrentTask = task;
+        function(param);
+    }).detach();
+    return pdTRUE;
+}
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return hostCurrentTask; }
+// Real time passes, as a task which waits on the fake clock would never wake
+inline void vTaskDelay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->count++;
+    task->notified.notify_one();
+}
+inline uint32_t ulTaskNotifyTake(int clear, uint32_t) {
+    TaskHandle_t task = hostCurrentTask;
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->notified.wait(lock, [&] { return task->count > 0; });
+    const uint32_t count = task->count;
+    task->count = clear ? 0 : count - 1;
+    return count;
+}
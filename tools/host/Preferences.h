@@ -0,0 +1,45 @@
+#pragma once
+#include "Arduino.h"
+#include <map>
+
+// NVS as a map, which starts empty on each run, so every preference reads
+// as its default until a tool puts one
+class Preferences {
+  public:
+    bool begin(const char *) { return true; }
+    void end() {}
+    bool clear() { return values.clear(), true; }
+    bool isKey(const char *key) { return values.count(key); }
+
+    uint32_t getUInt(const char *key, uint32_t otherwise = 0) {
+        return isKey(key) ? strtoul(values[key].c_str(), nullptr, 10)
+                          : otherwise;
+    }
+    uint8_t getUChar(const char *key, uint8_t otherwise = 0) {
+        return getUInt(key, otherwise);
+    }
+    bool getBool(const char *key, bool otherwise = false) {
+        return getUInt(key, otherwise);
+    }
+    String getString(const char *key, String otherwise = String()) {
+        return isKey(key) ? String(values[key]) : otherwise;
+    }
+
+    size_t putUInt(const char *key, uint32_t value) {
+        values[key] = std::to_string(value);
+        return 4;
+    }
+    size_t putUChar(const char *key, uint8_t value) {
+        return putUInt(key, value) ? 1 : 0;
+    }
+    size_t putBool(const char *key, bool value) {
+        return putUInt(key, value) ? 1 : 0;
+    }
+    size_t putString(const char *key, const String &value) {
+        values[key] = value.c_str();
+        return value.length();
+    }
+
+  private:
+    std::map<std::string, std::string> values;
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+
+// The firmware's description. Tools may set the ELF hash, to pose as
+// different builds.
+struct esp_app_desc_t {
+    uint8_t app_elf_sha256[32];
+};
+esp_app_desc_t hostAppDesc = {};
+
+inline const esp_app_desc_t *esp_app_get_description() { return &hostAppDesc; }
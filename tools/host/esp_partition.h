@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Flash partitions. There are none unless a tool sets hostPartition, and
+// then it is emulated in hostFlash, where writes can only clear bits, as on
+// real flash.
+#define ESP_PARTITION_TYPE_DATA 1
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+struct esp_partition_t {
+    uint32_t size;
+};
+esp_partition_t *hostPartition = nullptr;
+std::vector<uint8_t> hostFlash; // hostPartition->size bytes
+uint32_t hostErases = 0;        // sectors erased, to measure wear
+
+inline const esp_partition_t *esp_partition_find_first(int, int,
+                                                       const char *) {
+    if (hostPartition)
+        hostFlash.resize(hostPartition->size, 0xff);
+    return hostPartition;
+}
+inline int esp_partition_read(const esp_partition_t *, size_t at, void *data,
+                              size_t size) {
+    memcpy(data, &hostFlash[at], size);
+    return 0;
+}
+inline int esp_partition_write(const esp_partition_t *, size_t at,
+                               const void *data, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        hostFlash[at + i] &= ((const uint8_t *)data)[i];
+    return 0;
+}
+inline int esp_partition_erase_range(const esp_partition_t *, size_t at,
+                                     size_t size) {
+    hostErases += size / 4096;
+    memset(&hostFlash[at], 0xff, size);
+    return 0;
+}
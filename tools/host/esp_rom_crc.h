@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+
+// The ROM's CRC-32, bit by bit rather than by table
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf,
+                                 uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+            crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
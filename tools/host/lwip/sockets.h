@@ -0,0 +1,8 @@
+#pragma once
+// The host's own sockets, so UDP telemetry really is sent. Linux has no
+// sin_len, and doesn't define LWIP_SOCKET, which is how code tells.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,113 @@
+// Benchmark frame_delta.hpp, the web preview's compression, on a PC.
+//
+//   g++ -O2 -std=c++17 -I src tools/preview_bench.cpp -o preview_bench
+//   ./preview_bench [recording.rgb ...]
+//
+// A recording is frames of raw leds[], as saved by the Record button under
+// the preview on the index page. Without one, frames of 32x32 are made up,
+// shaped like the sketch's effects. For each, it prints the mean bytes per
+// frame, the ratio to sending frames raw, and the encoder's throughput, and
+// checks every frame decodes exactly.
+
+#include "frame_delta.hpp"
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+const uint16_t frameSize = 32 * 32 * 3;
+
+typedef std::vector<std::vector<uint8_t>> Frames;
+
+// Measure the encoder on some frames, sending a key frame every keyEvery
+bool bench(const char *name, const Frames &frames, int keyEvery = 100) {
+    if (frames.empty())
+        return true;
+    FrameEncoder<frameSize> encoder;
+    std::vector<uint8_t> out(encoder.maxSize), decoded(frameSize);
+    size_t bytes = 0, sent = 0;
+    double seconds = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        const bool key = 0 == f % keyEvery;
+        const auto start = std::chrono::steady_clock::now();
+        const size_t size = encoder.encode(frames[f].data(), out.data(), key);
+        seconds += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+        if (!key && size == FRAME_DELTA_HEADER)
+            continue; // unchanged, so not sent
+        sent++, bytes += size;
+        if (!frameDecode(out.data(), size, decoded.data(), frameSize) ||
+            decoded != frames[f]) {
+            printf("%s: frame %zu decoded wrongly\n", name, f);
+            return false;
+        }
+    }
+    const double mean = sent ? double(bytes) / sent : 0;
+    printf("%-12s %6zu %6zu %8.0f %6.1fx %8.0f\n", name, frames.size(), sent,
+           mean, mean ? frameSize / mean : 0,
+           frames.size() * frameSize / seconds / 1e6);
+    return true;
+}
+
+// Frames made up to look like the sketch's effects, at the preview's 10 fps
+Frames synthesise(const std::string &kind) {
+    Frames frames;
+    std::mt19937 random(1);
+    for (int f = 0; f < 600; f++) {
+        std::vector<uint8_t> frame(frameSize);
+        const float t = f / 10.f;
+        for (int y = 0; y < 32; y++) {
+            for (int x = 0; x < 32; x++) {
+                uint8_t *rgb = &frame[(y * 32 + x) * 3];
+                if ("plasma" == kind) { // every pixel changes, smoothly
+                    rgb[0] = 127 + 127 * sinf(x * .3f + t);
+                    rgb[1] = 127 + 127 * sinf(y * .2f + t * .7f);
+                    rgb[2] = 127 + 127 * sinf((x + y) * .15f + t * 1.3f);
+                } else if ("ripples" == kind) { // rings on black, like FxSui
+                    const float d = hypotf(x - 12, y - 20);
+                    const float ring = fmodf(t * 6, 40) - d;
+                    const uint8_t v = fabsf(ring) < 1.5f ? 200 - 4 * d : 0;
+                    rgb[0] = v / 4, rgb[1] = v / 2, rgb[2] = v;
+                } else if ("slow" == kind) { // slowly drifting palette noise
+                    const int v = 128 + 100 * sinf(x * .2f + t * .05f) *
+                                            cosf(y * .2f - t * .03f);
+                    rgb[0] = v, rgb[1] = v / 3, rgb[2] = 255 - v;
+                } else { // "random", the worst case
+                    rgb[0] = random(), rgb[1] = random(), rgb[2] = random();
+                }
+            }
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+Frames load(const char *path) {
+    Frames frames;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return frames;
+    }
+    std::vector<uint8_t> frame(frameSize);
+    while (fread(frame.data(), 1, frameSize, file) == frameSize)
+        frames.push_back(frame);
+    fclose(file);
+    return frames;
+}
+
+int main(int argc, char **argv) {
+    printf("%-12s %6s %6s %8s %7s %8s\n", "frames", "count", "sent", "B/frame",
+           "ratio", "MB/s");
+    bool ok = true;
+    if (argc > 1)
+        for (int i = 1; i < argc; i++)
+            ok &= bench(argv[i], load(argv[i]));
+    else
+        for (const char *kind : {"plasma", "ripples", "slow", "random"})
+            ok &= bench(kind, synthesise(kind));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// Replay radar captures on a PC: parse the LD2450 byte stream, follow the
+// targets with the sketch's RadarTracker, and time both.
+//
+//   g++ -O2 -std=c++17 -I src -o radar_replay tools/radar_replay.cpp
+//   ./radar_replay [radar.cap ...]
+//
+// A capture is /radar.cap, downloaded from the device's web server after
+// recording with the "radar_capture" preference set to 1, or the records
+// sent with it set to 2, saved with `nc -lu 47270 > radar.cap`. Without one,
+// a minute of a target walking to and fro is made up.
+//
+// For each, it prints the reports parsed and the bytes skipped finding them,
+// the gaps between reports as the sensor sent them, the parser's throughput,
+// and the time to update the tracker with a report and to predict a target,
+// which radarDraw() does for every target on every frame.
+
+#include "radar_record.hpp"
+#include "tracker.hpp"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct Record {
+    uint32_t ms;
+    std::vector<uint8_t> bytes;
+};
+
+struct Report {
+    uint32_t ms;
+    Detection detections[TRACKER_MAX_TRACKS];
+    uint8_t count;
+};
+
+// The LD2450 sends a report of 30 bytes: AA FF 03 00, three targets of x, y,
+// speed and resolution, then 55 CC. Coordinates are little-endian, with the
+// top bit set for positive values. A target of all zeros isn't there.
+class ReportParser {
+  public:
+    uint32_t skipped = 0; // bytes which weren't part of a report
+
+    bool parse(uint8_t c, Report &report) {
+        static const uint8_t head[4] = {0xaa, 0xff, 0x03, 0x00};
+        if (length < 4 && c != head[length]) {
+            skipped += length + (c != head[0]);
+            length = c == head[0];
+            return false;
+        }
+        frame[length++] = c;
+        if (length < sizeof(frame))
+            return false;
+        length = 0;
+        if (0x55 != frame[28] || 0xcc != frame[29]) {
+            skipped += sizeof(frame);
+            return false;
+        }
+        report.count = 0;
+        for (int i = 0; i < 3; i++) {
+            const uint8_t *target = frame + 4 + i * 8;
+            bool present = false;
+            for (int j = 0; j < 8; j++)
+                present |= target[j];
+            if (present)
+                report.detections[report.count++] = {coordinate(target),
+                                                     coordinate(target + 2)};
+        }
+        return true;
+    }
+
+  private:
+    uint8_t frame[30];
+    size_t length = 0;
+
+    static float coordinate(const uint8_t *p) {
+        const uint16_t raw = p[0] | p[1] << 8;
+        return raw & 0x8000 ? raw & 0x7fff : -(raw & 0x7fff);
+    }
+};
+
+// Encode a report as the sensor would
+void encode(const Report &report, std::vector<uint8_t> &out) {
+    const uint8_t head[4] = {0xaa, 0xff, 0x03, 0x00};
+    out.insert(out.end(), head, head + 4);
+    for (int i = 0; i < 3; i++) {
+        uint8_t target[8] = {};
+        if (i < report.count) {
+            const float xy[2] = {report.detections[i].x,
+                                 report.detections[i].y};
+            for (int j = 0; j < 2; j++) {
+                const uint16_t v = uint16_t(fabsf(xy[j])) & 0x7fff;
+                const uint16_t raw = xy[j] >= 0 ? v | 0x8000 : v;
+                target[j * 2] = raw, target[j * 2 + 1] = raw >> 8;
+            }
+            target[6] = 0x68, target[7] = 0x01; // resolution 360mm
+        }
+        out.insert(out.end(), target, target + 8);
+    }
+    out.push_back(0x55), out.push_back(0xcc);
+}
+
+// A target walking to and fro in front of the sensor at about 1m/s, reported
+// every 100ms, in records split as a UART delivers them
+std::vector<Record> synthesise() {
+    std::vector<Record> records;
+    std::vector<uint8_t> bytes;
+    for (uint32_t ms = 0; ms < 60000; ms += 100) {
+        Report report{ms, {}, 1};
+        const float t = ms / 1000.f;
+        report.detections[0] = {1500 * sinf(t / 3), 2500 + 1000 * cosf(t / 2)};
+        bytes.clear();
+        encode(report, bytes);
+        records.push_back({ms, {bytes.begin(), bytes.begin() + 16}});
+        records.push_back({ms + 1, {bytes.begin() + 16, bytes.end()}});
+    }
+    return records;
+}
+
+std::vector<Record> load(const char *path) {
+    std::vector<Record> records;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return records;
+    }
+    RadarCaptureHeader header;
+    while (fread(&header, sizeof(header), 1, file) == 1) {
+        Record record{header.ms, std::vector<uint8_t>(header.len)};
+        if (fread(record.bytes.data(), 1, header.len, file) != header.len)
+            break; // a capture cut short while recording
+        records.push_back(record);
+    }
+    fclose(file);
+    return records;
+}
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+}
+
+bool replay(const char *name, const std::vector<Record> &records) {
+    if (records.empty()) {
+        printf("%s: no records\n", name);
+        return false;
+    }
+
+    // Parse, timing the parser alone, and stamping each report with the
+    // record it completed in, as radarTask() would
+    const int passes = 20;
+    std::vector<Report> reports;
+    size_t bytes = 0;
+    uint32_t skipped = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        ReportParser parser;
+        Report report;
+        reports.clear();
+        for (const Record &record : records)
+            for (uint8_t c : record.bytes)
+                if (parser.parse(c, report))
+                    report.ms = record.ms, reports.push_back(report);
+        skipped = parser.skipped;
+    }
+    const double parseSeconds = seconds(start);
+    for (const Record &record : records)
+        bytes += record.bytes.size();
+
+    std::vector<uint32_t> gaps;
+    for (size_t i = 1; i < reports.size(); i++)
+        gaps.push_back(reports[i].ms - reports[i - 1].ms);
+    std::sort(gaps.begin(), gaps.end());
+    auto gap = [&](double q) {
+        return gaps.empty() ? 0u : gaps[size_t(q * (gaps.size() - 1))];
+    };
+
+    // Track, then predict each target at 100 frames a second until the next
+    // report, timing each separately
+    RadarTracker tracker;
+    double updateSeconds = 0, predictSeconds = 0;
+    size_t predictions = 0;
+    volatile float sink = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        tracker = RadarTracker();
+        for (size_t i = 0; i < reports.size(); i++) {
+            const Report &report = reports[i];
+            start = std::chrono::steady_clock::now();
+            tracker.update(report.ms, report.detections, report.count);
+            updateSeconds += seconds(start);
+
+            const uint32_t until =
+                i + 1 < reports.size() ? reports[i + 1].ms : report.ms + 100;
+            start = std::chrono::steady_clock::now();
+            for (uint32_t ms = report.ms; ms < until; ms += 10)
+                for (int t = 0; t < TRACKER_MAX_TRACKS; t++) {
+                    float x, y;
+                    if (tracker.predict(t, ms, x, y))
+                        sink = sink + x + y, predictions++;
+                }
+            predictSeconds += seconds(start);
+        }
+    }
+
+    printf("%s: %zu records, %zu bytes over %.1fs\n", name, records.size(),
+           bytes, (records.back().ms - records.front().ms) / 1000.);
+    printf("  reports   %zu, %u bytes skipped\n", reports.size(), skipped);
+    printf("  gaps      median %ums, 99%% %ums, max %ums\n", gap(.5), gap(.99),
+           gap(1));
+    printf("  parse     %.1f MB/s\n", passes * bytes / parseSeconds / 1e6);
+    printf("  update    %.0f ns/report\n",
+           reports.empty() ? 0 : updateSeconds * 1e9 / reports.size() / passes);
+    printf("  predict   %.0f ns/target\n",
+           predictions ? predictSeconds * 1e9 / predictions : 0);
+    return !reports.empty();
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    if (argc > 1)
+        for (int i = 1; i < argc; i++)
+            ok &= replay(argv[i], load(argv[i]));
+    else
+        ok = replay("walking", synthesise());
+    return ok ? 0 : 1;
+}
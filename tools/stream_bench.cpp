@@ -0,0 +1,247 @@
+/*
+
+Measure the pixel stream receiver on Linux: send frames to StreamReceiver
+over loopback in each protocol, as a show controller would, and time how
+long from sending a frame's packets until the frame is published for
+FxStream to draw, then how many pixels a second it can take.
+
+    g++ -O2 -std=c++17 -I tools/host -I src -o stream_bench \
+        tools/stream_bench.cpp -lpthread
+    ./stream_bench [seconds]
+
+The receiver is the sketch's own, with its task as a thread and real
+sockets, for a 32x32 matrix with the XYMap remap of a serpentine layout.
+Every frame received while timing latency is checked pixel by pixel.
+Throughput is measured by sending frames as fast as one thread can, so it
+is the receiver's limit or the sender's, whichever is lower, and packets
+the kernel dropped show up as lost.
+
+*/
+
+#define TELEMETRY_IN_LOOP
+#include "telemetry.hpp"
+Telemetry telemetry;
+#include "stream_udp.hpp"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+const uint16_t width = 32, height = 32, pixels = width * height;
+const size_t frameSize = pixels * 3;
+
+// Syncs last, as a receiver which has seen one waits 4s for the next
+enum Mode { ddp, e131, artnet, e131Sync, artnetSync, modes };
+const char *modeNames[modes] = {"DDP", "E1.31", "Art-Net", "E1.31 sync",
+                                "Art-Net sync"};
+const uint16_t syncAddress = 7000;
+
+// Builds the datagrams for a frame, as a show controller would
+struct Sender {
+    int sock;
+    sockaddr_in to[3] = {};
+    uint32_t sequence = 0; // frames sent
+    std::vector<uint8_t> packet;
+
+    Sender() : sock(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) {
+        for (int protocol = 0; protocol < 3; protocol++) {
+            to[protocol].sin_family = AF_INET;
+            to[protocol].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        }
+    }
+
+    void put16(size_t at, uint16_t v) {
+        packet[at] = v >> 8, packet[at + 1] = v;
+    }
+    void put32(size_t at, uint32_t v) {
+        put16(at, v >> 16), put16(at + 2, v);
+    }
+    void send(int protocol) {
+        sendto(sock, packet.data(), packet.size(), 0,
+               (sockaddr *)&to[protocol], sizeof(to[protocol]));
+    }
+
+    void ddpPacket(uint32_t offset, const uint8_t *data, uint16_t len,
+                   bool push) {
+        packet.assign(10 + len, 0);
+        packet[0] = 0x40 | push;
+        packet[1] = sequence % 15 + 1;
+        packet[2] = 0x0b, packet[3] = 1;
+        put32(4, offset), put16(8, len);
+        memcpy(&packet[10], data, len);
+        send(streamDDP);
+    }
+    void e131Root(size_t size, uint32_t vector) {
+        packet.assign(size, 0);
+        put16(0, 0x0010);
+        memcpy(&packet[4], "ASC-E1.17", 9);
+        put16(16, 0x7000 | (size - 16));
+        put32(18, vector);
+        put16(38, 0x7000 | (size - 38));
+    }
+    void e131Packet(uint16_t universe, const uint8_t *data, uint16_t len,
+                    uint16_t sync) {
+        e131Root(126 + len, 4);
+        put32(40, 2);
+        packet[108] = 100; // priority
+        put16(109, sync);
+        packet[111] = uint8_t(sequence);
+        put16(113, universe);
+        put16(115, 0x7000 | (len + 11));
+        packet[117] = 2, packet[118] = 0xa1;
+        put16(121, 1), put16(123, len + 1);
+        memcpy(&packet[126], data, len);
+        send(streamE131);
+    }
+    void e131SyncPacket() {
+        e131Root(49, 8);
+        put32(40, 1);
+        packet[44] = uint8_t(sequence);
+        put16(45, syncAddress);
+        send(streamE131);
+    }
+    void artnetHeader(size_t size, uint16_t opcode) {
+        packet.assign(size, 0);
+        memcpy(&packet[0], "Art-Net", 8);
+        packet[8] = opcode, packet[9] = opcode >> 8;
+        packet[11] = 14;
+    }
+    void artDmx(uint16_t universe, const uint8_t *data, uint16_t len) {
+        artnetHeader(18 + len, 0x5000);
+        packet[12] = sequence % 255 + 1;
+        packet[14] = universe, packet[15] = universe >> 8;
+        put16(16, len);
+        memcpy(&packet[18], data, len);
+        send(streamArtNet);
+    }
+
+    // Send a whole frame, in rows from the top left
+    void frame(Mode mode, const uint8_t *data) {
+        if (ddp == mode) {
+            for (size_t at = 0; at < frameSize; at += 1440) {
+                const uint16_t len = std::min<size_t>(1440, frameSize - at);
+                ddpPacket(at, data + at, len, at + len == frameSize);
+            }
+        } else {
+            for (size_t at = 0, u = 0; at < frameSize; at += 510, u++) {
+                const uint16_t len = std::min<size_t>(510, frameSize - at);
+                if (artnet == mode || artnetSync == mode)
+                    artDmx(u, data + at, len);
+                else
+                    e131Packet(1 + u, data + at, len,
+                               e131Sync == mode ? syncAddress : 0);
+            }
+            if (e131Sync == mode)
+                e131SyncPacket();
+            if (artnetSync == mode)
+                artnetHeader(14, 0x5200), send(streamArtNet);
+        }
+        sequence++;
+    }
+};
+
+// A frame which differs everywhere from the last, numbered in its first
+// pixels
+void makeFrame(uint32_t n, uint8_t *data) {
+    for (size_t i = 0; i < frameSize; i++)
+        data[i] = i * 7 + n * 13;
+    memcpy(data, &n, 4);
+}
+
+template <typename T> T percentile(std::vector<T> v, double p) {
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, size_t(p * v.size()))];
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 2;
+
+    // Serpentine rows from the bottom left, like the panels
+    std::vector<uint16_t> remap(pixels);
+    for (uint16_t y = 0; y < height; y++)
+        for (uint16_t x = 0; x < width; x++) {
+            const uint16_t row = height - 1 - y; // the stream starts at the top
+            remap[y * width + x] = row * width + (row & 1 ? width - 1 - x : x);
+        }
+
+    // Ports from the ones the receiver actually bound
+    const uint16_t ports[3] = {24048, 25568, 26454};
+    preferences.putUInt("stream_ddp_port", ports[0]);
+    preferences.putUInt("stream_e131_port", ports[1]);
+    preferences.putUInt("stream_artnet_port", ports[2]);
+    telemetry.begin();
+    static StreamReceiver<pixels> receiver;
+    if (!receiver.begin(remap.data())) {
+        printf("Failed to bind the receiver's ports\n");
+        return 1;
+    }
+    Sender sender;
+    for (int protocol = 0; protocol < 3; protocol++)
+        sender.to[protocol].sin_port = htons(ports[protocol]);
+
+    printf("%u pixels, %zu bytes per frame\n", pixels, frameSize);
+    printf("%-13s %8s %8s %5s %8s %8s %9s %7s %7s\n", "", "median", "p99",
+           "bad", "sent/s", "frames/s", "Mpixel/s", "lost", "incompl");
+    bool ok = true;
+    std::vector<uint8_t> frame(frameSize), expected(frameSize);
+    for (int mode = 0; mode < modes; mode++) {
+        receiver.update(); // discard any frame left from the last mode
+
+        // Latency: one frame at a time, from the start of its first packet
+        // until the receiver publishes it
+        std::vector<uint32_t> latencies;
+        uint32_t bad = 0;
+        for (uint32_t n = 0; n < 2000; n++) {
+            makeFrame(n, frame.data());
+            const uint32_t start = micros();
+            sender.frame(Mode(mode), frame.data());
+            while (!receiver.update() && micros() - start < 100000)
+                ;
+            const auto &received = receiver.front();
+            for (uint16_t i = 0; i < pixels; i++)
+                memcpy(&expected[remap[i] * 3], &frame[i * 3], 3);
+            if (memcmp(received.pixels, expected.data(), frameSize)) {
+                bad++;
+                continue;
+            }
+            latencies.push_back(received.µs - start);
+        }
+        ok &= !bad;
+
+        // Throughput: frames as fast as a thread can send them
+        const uint32_t frames = receiver.received();
+        const uint32_t lost = receiver.counts().lost;
+        const uint32_t incomplete = receiver.counts().incomplete;
+        std::atomic<bool> sending{true};
+        uint32_t sent = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::thread blast([&] {
+            std::vector<uint8_t> data(frameSize);
+            for (; sending; sent++) {
+                makeFrame(sent, data.data());
+                sender.frame(Mode(mode), data.data());
+            }
+        });
+        while (std::chrono::steady_clock::now() - start <
+               std::chrono::duration<double>(seconds)) {
+            receiver.update(); // as FxStream would, at 1000 fps
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sending = false;
+        blast.join();
+        const double elapsed = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // drain
+        const double fps = (receiver.received() - frames) / elapsed;
+        printf("%-13s %5u us %5u us %5u %8.0f %8.0f %9.1f %7u %7u\n",
+               modeNames[mode], percentile(latencies, 0.5),
+               percentile(latencies, 0.99), bad, sent / elapsed, fps,
+               fps * pixels / 1e6, receiver.counts().lost - lost,
+               receiver.counts().incomplete - incomplete);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    fflush(stdout);
+    _exit(ok ? 0 : 1); // without waiting for the receiver's thread
+}
@@ -0,0 +1,139 @@
+/*
+
+Benchmark Telemetry's update paths on Linux: set() by handle against add() by
+name, the heap allocations each makes once warmed up, and how long add()
+waits for the registry lock while send() coalesces on another thread, as the
+telemetry task does.
+
+    g++ -O2 -std=c++17 -I tools/host -I src -o telemetry_bench \
+        tools/telemetry_bench.cpp -lpthread
+    ./telemetry_bench [data]
+
+Allocations are counted by replacing the global operator new, which the host
+String and every container use. The device's benchmarkTelemetry() measures
+set() and add() there, and counts heap blocks instead.
+
+*/
+
+#define TELEMETRY_IN_LOOP    // call send() from here, rather than from a task
+#define TELEMETRY_POSTS 1024 // room for a batch of updates between sends
+#include "telemetry.hpp"
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+Telemetry telemetry;
+
+std::atomic<uint64_t> allocations{0};
+
+// Out of line, or GCC sees malloc() and free() paired with new and delete,
+// and warns
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+double nowSeconds() {
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Time batches of updates which fit in the queue, applying and coalescing
+// them with send() between batches, untimed. Returns updates per second,
+// and counts the allocations made by the updates alone.
+template <typename Update>
+double bench(Update update, uint64_t &updateAllocations) {
+    const int batch = 512, batches = 200;
+    double seconds = 0;
+    updateAllocations = 0;
+    for (int b = 0; b < batches; b++) {
+        const uint64_t before = allocations;
+        const double start = nowSeconds();
+        for (int i = 0; i < batch; i++)
+            update(b * batch + i);
+        seconds += nowSeconds() - start;
+        updateAllocations += allocations - before;
+        hostMillis += 100;
+        telemetry.send();
+    }
+    return batch * batches / seconds;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t count = argc > 1 ? atoi(argv[1]) : 100;
+    flags.udpTelemetry = flags.serialTelemetry = false;
+    telemetry.begin();
+
+    std::vector<Telemetry::Handle> handles;
+    std::vector<String> names;
+    for (uint32_t i = 0; i < count; i++) {
+        names.push_back("bench " + String(i));
+        handles.push_back(telemetry.add(names.back(), {.unit = "ms"}));
+        if (Telemetry::none == handles.back()) {
+            printf("Only room for %u data; raise TELEMETRY_DATA\n", i);
+            return 1;
+        }
+    }
+
+    // Warm up, so Strings and the history have grown to their steady sizes
+    uint64_t warm;
+    bench([&](int i) { telemetry.set(handles[i % count], i / 100.f); }, warm);
+
+    uint64_t setAllocations, addAllocations, sendAllocations;
+    const double setRate = bench(
+        [&](int i) { telemetry.set(handles[i % count], i / 100.f); },
+        setAllocations);
+    const double addRate = bench(
+        [&](int i) { telemetry.add(names[i % count], String(i / 100.f)); },
+        addAllocations);
+    const uint64_t before = allocations;
+    for (int i = 0; i < 100; i++) {
+        for (uint32_t h = 0; h < count; h++)
+            telemetry.set(handles[h], i + h / 100.f);
+        hostMillis += 1000;
+        telemetry.send();
+    }
+    sendAllocations = allocations - before;
+
+    printf("%u data\n", count);
+    printf("set():  %10.0f updates/s, %llu allocations\n", setRate,
+           (unsigned long long)setAllocations);
+    printf("add():  %10.0f updates/s, %llu allocations\n", addRate,
+           (unsigned long long)addAllocations);
+    printf("send(): %.1f allocations per call, with every datum changed\n",
+           sendAllocations / 100.);
+
+    // add() only takes the lock to look up the name, so it shouldn't wait
+    // for send(), however long coalescing takes. The max includes any time
+    // slice the OS gave the sender instead, on a machine short of cores.
+    std::atomic<bool> done{false};
+    std::thread sender([&] {
+        while (!done) {
+            for (uint32_t h = 0; h < count; h++)
+                telemetry.set(handles[h], float(h));
+            hostMillis += 100;
+            telemetry.send();
+        }
+    });
+    std::vector<double> waits;
+    for (int i = 0; i < 100000; i++) {
+        const double start = nowSeconds();
+        telemetry.add(names[i % count], "");
+        waits.push_back(nowSeconds() - start);
+    }
+    done = true;
+    sender.join();
+    std::sort(waits.begin(), waits.end());
+    printf("add() while sending: %.2f us median, %.2f us p99.9, %.1f us max\n",
+           waits[waits.size() / 2] * 1e6,
+           waits[waits.size() * 999 / 1000] * 1e6, waits.back() * 1e6);
+    fflush(stdout);
+    _exit(0); // without waiting for the resolver's thread
+}
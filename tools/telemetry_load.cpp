@@ -0,0 +1,221 @@
+/*
+
+Load test Telemetry on Linux. Register many data with mixed intervals,
+update them from a simulated render loop, and receive the UDP telemetry on a
+real socket, to measure what coalescing costs, how many packets are sent,
+and how long updates wait to reach the wire.
+
+    g++ -O2 -std=c++17 -I tools/host -I src -o telemetry_load \
+        tools/telemetry_load.cpp -lpthread
+    ./telemetry_load [data] [seconds] [telemetry_bps]
+
+Time is simulated by the fake clock of tools/host/Arduino.h, so minutes pass
+in seconds. Latency is in simulated ms, from a value being set until the
+packet reporting it arrives; values which were overwritten before being sent
+are counted as coalesced. CPU times are real. "Coalesce" is the datum
+Telemetry sends about itself, received like any other.
+
+The test updates thousands of values per 100ms, so it enlarges the queue of
+set() values. "Telemetry drops" counts any which still didn't fit.
+
+*/
+
+#define TELEMETRY_IN_LOOP // call send() from here, rather than from a task
+#define TELEMETRY_POSTS 4096 // room for every update between sends
+#define TELEMETRY_DATA 8192  // room for 2000 data, all of them aggregates
+#include "telemetry.hpp"
+#include <algorithm>
+#include <deque>
+#include <fcntl.h>
+
+Telemetry telemetry;
+
+// A registered datum, and the updates it has been sent
+struct Load {
+    Telemetry::Handle handle;
+    int interval;      // index of minMs
+    uint32_t updateMs; // how often it's updated
+    bool integer, aggregate;
+    uint32_t next = 0;          // the next value, which counts updates
+    uint32_t reported = 0;      // values below this have been reported
+    std::deque<uint32_t> setMs; // when each unreported value was set
+};
+
+const uint32_t minMs[] = {200, 500, 1000, 2000, 5000};
+const int intervals = sizeof(minMs) / sizeof(minMs[0]);
+
+struct Stats {
+    std::vector<uint32_t> latencyMs[intervals]; // by minMs
+    uint64_t updates = 0, coalesced = 0;
+    uint64_t packets = 0, bytes = 0, reports = 0;
+    double coalesceSum = 0; // from the "Coalesce" datum's mean and count
+    uint32_t coalesceCount = 0;
+    float coalesceMax = 0;
+    uint32_t drops = 0; // the "Telemetry drops" datum
+};
+
+template <typename T> T percentile(std::vector<T> v, double p) {
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, size_t(p * v.size()))];
+}
+
+// Value v of a datum arrived, so it and every value before it have gone
+void reported(Load &load, uint32_t value, Stats &stats) {
+    if (value < load.reported || value >= load.next)
+        return; // a repeat from maxMs, or garbage
+    const size_t skipped = value - load.reported;
+    stats.coalesced += skipped;
+    stats.latencyMs[load.interval].push_back(millis() - load.setMs[skipped]);
+    load.setMs.erase(load.setMs.begin(), load.setMs.begin() + skipped + 1);
+    load.reported = value + 1;
+}
+
+// Parse each "name:value§unit|flags" line of a packet
+void receive(const char *packet, size_t size, std::vector<Load> &loads,
+             Stats &stats, float &coalesceMean) {
+    std::string text(packet, size);
+    size_t at = 0, end;
+    for (; (end = text.find('\n', at)) != std::string::npos; at = end + 1) {
+        const std::string line = text.substr(at, end - at);
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        stats.reports++;
+        const std::string name = line.substr(0, colon);
+        const float value = strtof(line.c_str() + colon + 1, nullptr);
+        unsigned index;
+        char suffix[8] = "";
+        if (name == "Coalesce") {
+            coalesceMean = value;
+        } else if (name == "Coalesce n") {
+            stats.coalesceSum += coalesceMean * value;
+            stats.coalesceCount += value;
+        } else if (name == "Coalesce max") {
+            stats.coalesceMax = std::max(stats.coalesceMax, value);
+        } else if (name == "Telemetry drops") {
+            stats.drops = value;
+        } else if (1 <= sscanf(name.c_str(), "load %u %7s", &index, suffix) &&
+                   index < loads.size()) {
+            // An aggregate's min is the oldest value in its window
+            Load &load = loads[index];
+            const bool isValue = load.aggregate ? !strcmp(suffix, "min")
+                                                : !suffix[0];
+            if (isValue)
+                reported(load, uint32_t(value), stats);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const uint32_t count = argc > 1 ? atoi(argv[1]) : 1000;
+    const uint32_t seconds = argc > 2 ? atoi(argv[2]) : 300;
+    const uint32_t bps = argc > 3 ? atoi(argv[3]) : 20000;
+
+    // Listen where Telemetry will send
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    const int buffer = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    if (bind(sock, (sockaddr *)&address, length) ||
+        getsockname(sock, (sockaddr *)&address, &length)) {
+        perror("bind");
+        return 1;
+    }
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+
+    preferences.putString("telemetry_host", "127.0.0.1");
+    preferences.putUInt("telemetry_port", ntohs(address.sin_port));
+    preferences.putUInt("telemetry_bps", bps);
+    flags.udpTelemetry = flags.wifiConnected = true;
+    flags.serialTelemetry = false;
+    telemetry.begin();
+
+    // Mixed intervals, types and priorities, updated every frame, every
+    // 100ms, every second, or every 10 seconds
+    const uint32_t maxMs[] = {5000, 10000, 60000};
+    const uint32_t updateMs[] = {16, 100, 1000, 10000};
+    std::vector<Load> loads(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Load &load = loads[i];
+        load.interval = i % intervals;
+        load.updateMs = updateMs[i / 5 % 4];
+        load.integer = 1 == i % 3;
+        load.aggregate = 16 == load.updateMs && 0 == i % 2;
+        Telemetry::Datum datum;
+        datum.minMs = minMs[load.interval];
+        datum.maxMs = maxMs[i % 3];
+        datum.aggregate = load.aggregate;
+        datum.priority = Telemetry::Priority(i % 3);
+        load.handle = telemetry.add("load " + String(i), datum);
+    }
+
+    Stats stats;
+    std::vector<uint32_t> sendMicros;
+    float coalesceMean = 0;
+    char packet[2048];
+    uint32_t sentMs = 0;
+    while (millis() < seconds * 1000) {
+        hostMillis += 16; // about 60 fps
+        for (Load &load : loads) {
+            if (millis() / load.updateMs == (millis() - 16) / load.updateMs)
+                continue;
+            const uint32_t value = load.next++;
+            load.setMs.push_back(millis());
+            stats.updates++;
+            if (load.integer)
+                telemetry.set(load.handle, value);
+            else
+                telemetry.set(load.handle, float(value) + 0.25f);
+        }
+
+        // As often as the telemetry task would
+        if (millis() - sentMs < 100)
+            continue;
+        sentMs = millis();
+        const uint32_t start = micros();
+        telemetry.send();
+        sendMicros.push_back(micros() - start);
+
+        ssize_t n;
+        while ((n = recv(sock, packet, sizeof(packet), 0)) > 0) {
+            stats.packets++, stats.bytes += n;
+            receive(packet, n, loads, stats, coalesceMean);
+        }
+    }
+
+    const double s = seconds;
+    uint64_t pending = 0;
+    for (const Load &load : loads)
+        pending += load.setMs.size();
+    printf("%u data for %u s at up to %u B/s\n", count, seconds, bps);
+    printf("coalesce: %.0f us mean over %u calls, %.0f us max\n",
+           stats.coalesceCount ? stats.coalesceSum / stats.coalesceCount : 0,
+           stats.coalesceCount, stats.coalesceMax);
+    printf("send(): %zu calls, %u us median, %u us p99\n", sendMicros.size(),
+           percentile(sendMicros, 0.5), percentile(sendMicros, 0.99));
+    printf("UDP: %.1f packets/s, %.0f B/s, %.1f reports/packet\n",
+           stats.packets / s, stats.bytes / s,
+           stats.packets ? double(stats.reports) / stats.packets : 0);
+    uint64_t sent = 0;
+    for (const auto &latencies : stats.latencyMs)
+        sent += latencies.size();
+    printf("updates: %llu, %.1f%% sent, %.1f%% coalesced, %llu pending, "
+           "%u dropped\n",
+           (unsigned long long)stats.updates, 100. * sent / stats.updates,
+           100. * stats.coalesced / stats.updates,
+           (unsigned long long)pending, stats.drops);
+    printf("latency to wire, ms:\n%8s %8s %8s %8s\n", "minMs", "median",
+           "p99", "max");
+    for (int i = 0; i < intervals; i++) {
+        const std::vector<uint32_t> &latencies = stats.latencyMs[i];
+        printf("%8u %8u %8u %8u\n", minMs[i], percentile(latencies, 0.5),
+               percentile(latencies, 0.99), percentile(latencies, 1.0));
+    }
+    fflush(stdout);
+    _exit(0); // without waiting for the resolver's thread
+}
@@ -0,0 +1,162 @@
+// Decode binary telemetry from the ESP32 back into Teleplot text, and forward
+// it to Teleplot on this PC. Text telemetry is forwarded as it is.
+//
+//   g++ -O2 -std=c++17 -I src tools/teleplot_bridge.cpp -o teleplot_bridge
+//   ./teleplot_bridge [listen port] [teleplot host] [teleplot port]
+//
+// Set the ESP32's telemetry_port preference to the listen port (default
+// 47268), and its binaryTelemetry preference to true. Every 10 seconds the
+// bridge prints the bytes/s received, and the bytes/s the same telemetry
+// would have taken as text.
+
+#include "telemetry_wire.hpp"
+#include <arpa/inet.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+struct Entry {
+    int decimals;
+    std::string name, unit, teleplot;
+};
+
+std::map<uint32_t, Entry> dictionary;
+uint16_t dictionarySession = 0;
+unsigned long unknownHandles = 0; // values received before their description
+
+// Teleplot doesn't like :|; in values
+void sanitise(std::string &value) {
+    const char *from[] = {":", "|", ";"};
+    const char *to[] = {"∶", "∣", "⁏"};
+    for (int i = 0; i < 3; i++)
+        for (size_t at = 0; (at = value.find(from[i], at)) != std::string::npos;
+             at += strlen(to[i]))
+            value.replace(at, 1, to[i]);
+}
+
+// Append the Teleplot text for a binary packet to out. Returns false if the
+// packet couldn't be decoded.
+bool decode(const uint8_t *data, size_t size, std::string &out) {
+    TelemetryReader in(data, size);
+    if (!in.begin())
+        return false;
+    if (in.session != dictionarySession)
+        dictionary.clear(), dictionarySession = in.session;
+
+    while (in.more()) {
+        size_t n;
+        const char *s;
+        if (wireDictionary == in.kind) {
+            Entry entry;
+            uint32_t handle = in.varint();
+            entry.decimals = in.byte();
+            s = in.string(n), entry.name.assign(s, n);
+            s = in.string(n), entry.unit.assign(s, n);
+            s = in.string(n), entry.teleplot.assign(s, n);
+            if (in.ok)
+                dictionary[handle] = entry;
+            continue;
+        }
+        if (wireValues != in.kind)
+            return false;
+
+        uint32_t key = in.varint();
+        std::string value;
+        char number[32];
+        float real = 0;
+        switch (key & 3) {
+        case wireInteger:
+            snprintf(number, sizeof(number), "%d", in.zigzag());
+            value = number;
+            break;
+        case wireReal:
+            real = in.real(); // formatted once its decimals are known
+            break;
+        case wireText:
+            s = in.string(n), value.assign(s, n);
+            sanitise(value);
+            break;
+        default:
+            return false;
+        }
+        auto it = dictionary.find(key >> 2);
+        if (!in.ok)
+            return false;
+        if (it == dictionary.end()) {
+            unknownHandles++;
+            continue;
+        }
+        const Entry &entry = it->second;
+        if (wireReal == (key & 3)) {
+            snprintf(number, sizeof(number), "%.*f", entry.decimals, real);
+            value = number;
+        }
+        out += entry.name + ":" + value;
+        if (entry.unit.size())
+            out += "§" + entry.unit;
+        if (entry.teleplot.size())
+            out += "|" + entry.teleplot;
+        out += "\n";
+    }
+    return in.ok;
+}
+
+int main(int argc, char **argv) {
+    const int listenPort = argc > 1 ? atoi(argv[1]) : 47268;
+    const char *teleplotHost = argc > 2 ? argv[2] : "127.0.0.1";
+    const int teleplotPort = argc > 3 ? atoi(argv[3]) : 47269;
+
+    int in = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int out = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in listenAddr{}, teleplotAddr{};
+    listenAddr.sin_family = AF_INET;
+    listenAddr.sin_port = htons(listenPort);
+    listenAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    teleplotAddr.sin_family = AF_INET;
+    teleplotAddr.sin_port = htons(teleplotPort);
+    if (in < 0 || out < 0 ||
+        bind(in, (sockaddr *)&listenAddr, sizeof(listenAddr)) < 0 ||
+        1 != inet_pton(AF_INET, teleplotHost, &teleplotAddr.sin_addr)) {
+        perror("teleplot_bridge");
+        return 1;
+    }
+    printf("Forwarding UDP port %d to %s:%d\n", listenPort, teleplotHost,
+           teleplotPort);
+
+    unsigned long bytesIn = 0, bytesText = 0, bad = 0;
+    time_t reportTime = time(nullptr);
+    uint8_t packet[65536];
+    for (;;) {
+        ssize_t len = recv(in, packet, sizeof(packet), 0);
+        if (len <= 0)
+            continue;
+        bytesIn += len;
+
+        std::string text;
+        if (TELEMETRY_WIRE_MAGIC != packet[0])
+            text.assign((const char *)packet, len);
+        else if (!decode(packet, len, text))
+            bad++;
+        bytesText += text.size();
+        if (text.size())
+            sendto(out, text.data(), text.size(), 0, (sockaddr *)&teleplotAddr,
+                   sizeof(teleplotAddr));
+
+        const time_t now = time(nullptr);
+        if (now - reportTime >= 10) {
+            const double seconds = now - reportTime;
+            printf("%.0f B/s received, %.0f B/s as text (%.0f%%), "
+                   "%lu bad packets, %lu unknown handles\n",
+                   bytesIn / seconds, bytesText / seconds,
+                   bytesText ? 100. * bytesIn / bytesText : 0., bad,
+                   unknownHandles);
+            fflush(stdout);
+            bytesIn = bytesText = 0;
+            reportTime = now;
+        }
+    }
+}